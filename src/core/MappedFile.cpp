@@ -0,0 +1,67 @@
+#include "MappedFile.hpp"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace mesher {
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(const char *file) {
+	file_ = CreateFileA(file, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if(file_ == INVALID_HANDLE_VALUE) {
+		file_ = nullptr;
+		return;
+	}
+	LARGE_INTEGER size;
+	if(!GetFileSizeEx(file_, &size)) return;
+	size_ = (size_t)size.QuadPart;
+	if(size_ == 0) {
+		open_ = true;
+		return;
+	}
+	mapping_ = CreateFileMappingA(file_, NULL, PAGE_READONLY, 0, 0, NULL);
+	if(!mapping_) return;
+	data_ = (const char*)MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0);
+	open_ = data_ != nullptr;
+}
+
+MappedFile::~MappedFile() {
+	if(data_) UnmapViewOfFile(data_);
+	if(mapping_) CloseHandle(mapping_);
+	if(file_) CloseHandle(file_);
+}
+
+#else
+
+MappedFile::MappedFile(const char *file) {
+	fd_ = ::open(file, O_RDONLY);
+	if(fd_ == -1) return;
+	struct stat s;
+	if(fstat(fd_, &s) != 0) return;
+	size_ = s.st_size;
+	if(size_ == 0) {
+		open_ = true;
+		return;
+	}
+	void *data = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd_, 0);
+	if(data == MAP_FAILED) return;
+	madvise(data, size_, MADV_SEQUENTIAL);
+	data_ = (const char*)data;
+	open_ = true;
+}
+
+MappedFile::~MappedFile() {
+	if(data_) munmap((void*)data_, size_);
+	if(fd_ != -1) close(fd_);
+}
+
+#endif
+
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+
+namespace mesher {
+
+// Read-only view of a whole file mapped in memory. data() is null when the file is empty.
+class MappedFile {
+	bool open_ = false;
+	const char *data_ = nullptr;
+	size_t size_ = 0;
+#ifdef _WIN32
+	void *file_ = nullptr, *mapping_ = nullptr;
+#else
+	int fd_ = -1;
+#endif
+
+public:
+	explicit MappedFile(const char *file);
+	~MappedFile();
+	MappedFile(const MappedFile &) = delete;
+	MappedFile &operator=(const MappedFile &) = delete;
+	bool open() {
+		return open_;
+	}
+	const char *data() {
+		return data_;
+	}
+	size_t size() {
+		return size_;
+	}
+};
+
+}
@@ -1,409 +1,1692 @@
 #include "Mesher.hpp"
 
+#include <algorithm>
+#include <climits>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
 #include <fstream>
 #include <iostream>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <unordered_set>
 
-#ifdef _WIN32
-#include <windows.h>
-#define CALLBACK __stdcall
-#else
-#define CALLBACK
-#endif
-
-#ifdef __APPLE__
-#include <OpenGL/glu.h>
-#else
-#include <GL/glu.h>
-#endif
+#include "MappedFile.hpp"
+#include "Parallel.hpp"
+#include "Simd.hpp"
+#include "TextParser.hpp"
+#include "TextWriter.hpp"
+#include "Triangulator.hpp"
+#include "VertexCache.hpp"
 
 namespace mesher {
 
 template <typename T>
-std::vector<T> operator+(const std::vector<T> &v0, const std::vector<T> &v1) { // useless now
-	std::vector<T> v;
-	v.reserve(v0.size() + v1.size());
-	v.insert(v.end(), v0.begin(), v0.end());
-	v.insert(v.end(), v1.begin(), v1.end());
-	return v;
+void Pack(std::vector<T> &v, const std::vector<int> &remap) {
+	int n = 0;
+	for(unsigned int i = 0; i < remap.size(); i++)
+		if(remap[i] != -1) v[n++] = v[i];
+	v.erase(v.begin() + n, v.end());
 }
 
 template <typename T>
-std::vector<T> &operator+=(std::vector<T> &v0, const std::vector<T> &v1) {
-	v0.reserve(v0.size() + v1.size());
-	v0.insert(v0.end(), v1.begin(), v1.end());
-	return v0;
+void Grow(std::vector<T> &v, size_t n) {
+	if(v.size() + n > v.capacity())
+		v.reserve(std::max(v.size() + n, v.capacity() * 2));
+}
+
+int Remapped(const std::vector<int> &remap, int i) {
+	return i == -1 ? -1 : remap[i];
 }
 
-void Mesher::LoadOperator(const char *file) {
-	std::ifstream ifs(file);
-	std::string op;
+bool IsBinary(const char *file) {
+	size_t n = strlen(file);
+	return n >= 4 && !strcmp(file + n - 4, ".opb");
+}
+
+const char OPB_MAGIC[4] = {'O', 'P', 'B', 1};
+
+struct OperatorHeader {
+	char magic[4]; // "OPB" and a version byte
+	uint32_t record_size;
+};
+
+const size_t OPERATOR_BATCH = 4096;
+
+static_assert(sizeof(glm::dvec3) == 3 * sizeof(double) && sizeof(glm::vec3) == 3 * sizeof(float),
+	"vertices are converted as flat arrays");
+
+bool Mesher::ReadOperator(const char *file, const std::function<bool(const Operator *o, size_t n)> &flush) {
+	if(IsBinary(file)) return ReadOperatorBinary(file, flush);
+
+	MappedFile mapped(file);
+	if(!mapped.open()) return false;
+	TextParser parser(mapped.data(), mapped.size());
+	auto Word = [&](const char *word, int length, const char *keyword) {
+		return length == (int)strlen(keyword) && !memcmp(word, keyword, length);
+	};
+	auto Point = [&](float &x, float &y, float &z) {
+		return parser.Expect('(') && parser.Float(x) && parser.Float(y) && parser.Float(z) && parser.Expect(')');
+	};
+
+	std::vector<Operator> batch;
+	batch.reserve(OPERATOR_BATCH);
+	const char *word;
+	int length;
 	float x, y, z, t;
 	int n0, n1, n2;
-	char c;
-
-	while(ifs >> op) {
-		if(op[0] == '#') {
-			ifs.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
-		} else if(op == "Mvfs") {
-			ifs.ignore(std::numeric_limits<std::streamsize>::max(), '(');
-			ifs >> x >> y >> z;
-			operator_.push_back(new EulerMvfs(x, y, z));
-			ifs.ignore(std::numeric_limits<std::streamsize>::max(), ')');
-		} else if(op == "Mve") {
-			ifs.ignore(std::numeric_limits<std::streamsize>::max(), '(');
-			ifs >> x >> y >> z;
-			ifs.ignore(std::numeric_limits<std::streamsize>::max(), ')');
-			ifs >> c >> n0 >> c >> n1;
-			operator_.push_back(new EulerMve(x, y, z, n0, n1));
-		} else if(op == "Mef") {
-			ifs >> c >> n0 >> c >> n1 >> c >> n2;
-			operator_.push_back(new EulerMef(n0, n1, n2));
-		} else if(op == "KeMr") {
-			ifs >> c >> n0 >> c >> n1;
-			operator_.push_back(new EulerKeMr(n0, n1));
-		} else if(op == "KfMrh") {
-			ifs >> n0 >> n1;
-			operator_.push_back(new EulerKfMrh(n0, n1));
-		} else if(op == "Sweep") {
-			ifs >> c >> n0;
-			ifs.ignore(std::numeric_limits<std::streamsize>::max(), '(');
-			ifs >> x >> y >> z;
-			ifs.ignore(std::numeric_limits<std::streamsize>::max(), ')');
-			ifs >> t;
-			operator_.push_back(new OpSweep(n0, x, y, z, t));
+	bool ok = true;
+	while(ok && !parser.End()) {
+		if(!parser.Word(word, length)) {
+			ok = false;
+		} else if(Word(word, length, "Mvfs")) {
+			if((ok = Point(x, y, z)))
+				batch.push_back(Operator(Euler_Mvfs, 0, 0, 0, glm::vec3(x, y, z)));
+		} else if(Word(word, length, "Mve")) {
+			if((ok = Point(x, y, z) && parser.Index('v', n0) && parser.Index('f', n1)))
+				batch.push_back(Operator(Euler_Mve, n0, n1, 0, glm::vec3(x, y, z)));
+		} else if(Word(word, length, "Mef")) {
+			if((ok = parser.Index('v', n0) && parser.Index('v', n1) && parser.Index('f', n2)))
+				batch.push_back(Operator(Euler_Mef, n0, n1, n2));
+		} else if(Word(word, length, "KeMr")) {
+			if((ok = parser.Index('e', n0) && parser.Index('f', n1)))
+				batch.push_back(Operator(Euler_KeMr, n0, n1, 0));
+		} else if(Word(word, length, "KfMrh")) {
+			if((ok = parser.Index('f', n0) && parser.Index('f', n1)))
+				batch.push_back(Operator(Euler_KfMrh, n0, n1, 0));
+		} else if(Word(word, length, "Sweep")) {
+			if((ok = parser.Index('f', n0) && Point(x, y, z) && parser.Float(t)))
+				batch.push_back(Operator(Op_Sweep, n0, 0, 0, glm::vec3(x, y, z), t));
+		} else {
+			ok = parser.Fail("unknown operator", word);
+		}
+		if(batch.size() == OPERATOR_BATCH) {
+			if(!flush(batch.data(), batch.size())) return false;
+			batch.clear();
+		}
+	}
+	if(!batch.empty() && !flush(batch.data(), batch.size())) return false;
+	if(!ok) std::cerr << file << ":" << parser.error() << std::endl;
+	return ok;
+}
+
+// The records are handed out in place from the mapping, the file is in native byte order.
+// Problems are reported on std::cerr with the record, the records before a bad one are
+// handed out.
+bool Mesher::ReadOperatorBinary(const char *file, const std::function<bool(const Operator *o, size_t n)> &flush) {
+	MappedFile mapped(file);
+	if(!mapped.open()) return false;
+	auto Fail = [&](const std::string &message) {
+		std::cerr << file << ": " << message << std::endl;
+		return false;
+	};
+	if(mapped.size() < sizeof(OperatorHeader)) return Fail("truncated header");
+	const OperatorHeader *header = (const OperatorHeader*)mapped.data();
+	if(memcmp(header->magic, OPB_MAGIC, 3)) return Fail("not a binary operator file");
+	if(header->magic[3] != OPB_MAGIC[3])
+		return Fail("version " + std::to_string(header->magic[3]) + ", expected " + std::to_string(OPB_MAGIC[3]));
+	if(header->record_size != sizeof(Operator))
+		return Fail("record size " + std::to_string(header->record_size) + ", expected " + std::to_string(sizeof(Operator)));
+
+	size_t n = (mapped.size() - sizeof(OperatorHeader)) / sizeof(Operator);
+	const Operator *record = (const Operator*)(mapped.data() + sizeof(OperatorHeader));
+	for(size_t i = 0; i < n; i += OPERATOR_BATCH) {
+		size_t m = std::min(n - i, OPERATOR_BATCH);
+		for(size_t j = i; j < i + m; j++)
+			if(record[j].op > Op_Sweep) {
+				if(j > i && !flush(record + i, j - i)) return false;
+				return Fail("record " + std::to_string(j) + ": unknown operator " + std::to_string(record[j].op));
+			}
+		if(!flush(record + i, m)) return false;
+	}
+	if((mapped.size() - sizeof(OperatorHeader)) % sizeof(Operator))
+		return Fail("record " + std::to_string(n) + ": truncated");
+	return true;
+}
+
+bool Mesher::LoadOperator(const char *file) {
+	return ReadOperator(file, [&](const Operator *o, size_t n) {
+		operator_.insert(operator_.end(), o, o + n);
+		return true;
+	});
+}
+
+// The file is read on a second thread and handed over in batches through a short queue,
+// so that only a few batches are alive at any time. Each batch is checked against the
+// kernel and built up to a Sweep at a time, since ids past a Sweep can only be checked once
+// it has run. The reader is stopped at the first bad operator.
+bool Mesher::BuildStream(const char *file) {
+	std::mutex mutex;
+	std::condition_variable cv;
+	std::deque<std::vector<Operator>> queue;
+	bool done = false, stop = false, ok = false;
+	std::thread reader([&]() {
+		bool read = ReadOperator(file, [&](const Operator *o, size_t n) {
+			std::unique_lock<std::mutex> lock(mutex);
+			cv.wait(lock, [&]() { return queue.size() < 4 || stop; });
+			if(stop) return false;
+			queue.push_back(std::vector<Operator>(o, o + n));
+			cv.notify_all();
+			return true;
+		});
+		std::lock_guard<std::mutex> lock(mutex);
+		ok = read;
+		done = true;
+		cv.notify_all();
+	});
+
+	bool valid = true;
+	size_t count = 0; // operators before the batch
+	Check check;
+	std::string error;
+	while(valid) {
+		std::vector<Operator> batch;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			cv.wait(lock, [&]() { return !queue.empty() || done; });
+			if(queue.empty()) break;
+			batch.swap(queue.front());
+			queue.pop_front();
+			cv.notify_all();
 		}
+		for(size_t i = 0; valid && i < batch.size();) {
+			StartCheck(check);
+			Count growth;
+			size_t end = i;
+			while(end < batch.size()) {
+				if(!CheckOperator(check, batch[end], growth, error)) {
+					std::cerr << file << ": operator " << count + end << " (" << ToString(batch[end]) << "): "
+						<< error << std::endl;
+					valid = false;
+					break;
+				}
+				if(batch[end++].op == Op_Sweep) break;
+			}
+			Reserve(growth.solid, growth.face, growth.loop, growth.edge, growth.half_edge, growth.vertex);
+			for(; i < end; i++) {
+				if(!CheckKernel(batch[i], error)) {
+					std::cerr << file << ": operator " << count + i << " (" << ToString(batch[i]) << "): "
+						<< error << std::endl;
+					valid = false;
+					break;
+				}
+				Execute(batch[i]);
+			}
+		}
+		count += batch.size();
+	}
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stop = true;
+		cv.notify_all();
 	}
-	ifs.close();
+	reader.join();
+	// the operators are not in the log, and the kernel no longer matches the operators
+	// undo would revert
+	undo_.clear();
+	undo_mark_.clear();
+	redo_.clear();
+
+	UpdateBorder();
+	return ok && valid;
 }
 
-void Mesher::SaveOperator(const char *file) {
+bool Mesher::SaveOperator(const char *file) {
+	if(IsBinary(file)) return SaveOperatorBinary(file);
+
 	std::ofstream ofs(file);
-	for(auto op: operator_)
-		ofs << op->ToString() << std::endl;
+	TextWriter w(&ofs);
+	for(auto &o: operator_) {
+		WriteOperator(w, o);
+		w.EndLine();
+	}
+	w.Flush();
 	ofs.close();
+	return (bool)ofs;
 }
 
-void Mesher::PrintOperator() {
-	for(auto op: operator_)
-		std::cout << op->ToString() << std::endl;
+bool Mesher::SaveOperatorBinary(const char *file) {
+	std::ofstream ofs(file, std::ios::binary);
+	OperatorHeader header;
+	memcpy(header.magic, OPB_MAGIC, 4);
+	header.record_size = sizeof(Operator);
+	ofs.write((const char*)&header, sizeof(header));
+	ofs.write((const char*)operator_.data(), sizeof(Operator) * operator_.size());
+	return (bool)ofs;
 }
 
-bool Mesher::InLoop(int v, Loop *l) {
-	HalfEdge *he = l->half_edge;
-	if(!he) return false;
-	do {
-		if(v == he->vertex) return true;
-		he = he->next;
-	} while(he != l->half_edge);
-	return false;
+bool Mesher::SaveMesh(const char *file) {
+	std::ofstream ofs(file, std::ios::binary);
+	uint32_t count[2] = {(uint32_t)mesh_vertex_.size(), (uint32_t)mesh_index_.size()};
+	ofs.write((const char*)count, sizeof(count));
+	ofs.write((const char*)mesh_vertex_.data(), sizeof(glm::vec3) * mesh_vertex_.size());
+	ofs.write((const char*)mesh_normal_.data(), sizeof(glm::vec3) * mesh_normal_.size());
+	ofs.write((const char*)mesh_index_.data(), sizeof(uint32_t) * mesh_index_.size());
+	return (bool)ofs;
 }
 
-void Mesher::AddLoop(int f, Loop *l1) {
-	Loop *l0 = face_[f]->loop;
+void Mesher::PrintOperator() {
+	TextWriter w(&std::cout);
+	for(auto &o: operator_) {
+		WriteOperator(w, o);
+		w.EndLine();
+	}
+	w.Flush();
+	std::cout.flush();
+}
 
-	l1->next = l0->next;
-	l1->prev = l0;
-	l0->next->prev = l1;
-	l0->next = l1;
+void Mesher::AddOperator(const Operator &o) {
+	operator_.push_back(o);
+	redo_.clear();
+}
 
-	l1->face = f;
+void Mesher::Execute(const Operator &o) {
+	switch(o.op) {
+	case Euler_Mvfs:
+		Mvfs(o.p());
+		break;
+	case Euler_Mve:
+		Mve(o.p(), o.n[0], o.n[1]);
+		break;
+	case Euler_Mef:
+		Mef(o.n[0], o.n[1], o.n[2]);
+		break;
+	case Euler_KeMr:
+		KeMr(o.n[0], o.n[1]);
+		break;
+	case Euler_KfMrh:
+		KfMrh(o.n[0], o.n[1]);
+		break;
+	case Op_Sweep:
+		Sweep(o.n[0], glm::dvec3(o.p()), o.x[3]);
+		break;
+	}
 }
 
-void Mesher::SetLoop(HalfEdge *he, Loop *l) {
-	do {
-		he->loop = l;
-		he = he->next;
-	} while(he != l->half_edge);
+void Mesher::WriteOperator(TextWriter &w, const Operator &o) {
+	auto Point = [&](const float *x) {
+		w.Char('(');
+		w.Float(x[0]);
+		w.Char(' ');
+		w.Float(x[1]);
+		w.Char(' ');
+		w.Float(x[2]);
+		w.Char(')');
+	};
+	switch(o.op) {
+	case Euler_Mvfs:
+		w.Word("Mvfs ");
+		Point(o.x);
+		break;
+	case Euler_Mve:
+		w.Word("Mve ");
+		Point(o.x);
+		w.Char(' ');
+		w.Index('v', o.n[0]);
+		w.Char(' ');
+		w.Index('f', o.n[1]);
+		break;
+	case Euler_Mef:
+		w.Word("Mef ");
+		w.Index('v', o.n[0]);
+		w.Char(' ');
+		w.Index('v', o.n[1]);
+		w.Char(' ');
+		w.Index('f', o.n[2]);
+		break;
+	case Euler_KeMr:
+		w.Word("KeMr ");
+		w.Index('e', o.n[0]);
+		w.Char(' ');
+		w.Index('f', o.n[1]);
+		break;
+	case Euler_KfMrh:
+		w.Word("KfMrh ");
+		w.Index('f', o.n[0]);
+		w.Char(' ');
+		w.Index('f', o.n[1]);
+		break;
+	case Op_Sweep:
+		w.Word("Sweep ");
+		w.Index('f', o.n[0]);
+		w.Char(' ');
+		Point(o.x);
+		w.Char(' ');
+		w.Float(o.x[3]);
+		break;
+	}
 }
 
-void Mesher::Mvfs(glm::vec3 p) {
-	solid_.push_back(new Solid);
-	face_.push_back(new Face);
-	vertex_.push_back(new Vertex(p));
-	Solid *s_p = solid_.back();
-	int s = solid_.size() - 1;
-	Face *f_p = face_.back();
-	int f = face_.size() - 1;
+std::string Mesher::ToString(const Operator &o) {
+	TextWriter w;
+	WriteOperator(w, o);
+	return w.buffer();
+}
 
-	Loop *l = new Loop(f);
+void Mesher::Touch(int f) {
+	if(f < (int)face_triangles_.size()) face_triangles_[f].dirty = true;
+	if(f < (int)face_border_.size() && !face_border_[f]) {
+		face_border_[f] = true;
+		border_face_.push_back(f);
+	}
+}
 
-	s_p->face = f;
+int Mesher::NewLoop(int face) {
+	int l;
+	if(free_loop_.empty()) {
+		l = loop_.size();
+		loop_.push_back(Loop(face, l));
+	} else {
+		l = free_loop_.back();
+		free_loop_.pop_back();
+		loop_[l] = Loop(face, l);
+	}
+	return l;
+}
 
-	f_p->solid = s;
-	f_p->loop = l;
+int Mesher::NewHalfEdge(int edge, int vertex) {
+	int he;
+	if(free_half_edge_.empty()) {
+		he = he_edge_.size();
+		he_next_.push_back(-1);
+		he_prev_.push_back(-1);
+		he_twin_.push_back(-1);
+		he_loop_.push_back(-1);
+		he_vertex_.push_back(vertex);
+		he_edge_.push_back(edge);
+	} else {
+		he = free_half_edge_.back();
+		free_half_edge_.pop_back();
+		he_next_[he] = he_prev_[he] = he_twin_[he] = he_loop_[he] = -1;
+		he_vertex_[he] = vertex;
+		he_edge_[he] = edge;
+	}
+	return he;
+}
 
-	l->prev = l->next = l;
-	l->face = f;
-	l->half_edge = nullptr;
+// Dead slots are all -1, so that undoing a kill gives back the same arrays.
+void Mesher::DeleteHalfEdge(int he) {
+	he_next_[he] = he_prev_[he] = he_twin_[he] = he_loop_[he] = -1;
+	he_vertex_[he] = he_edge_[he] = -1;
+	free_half_edge_.push_back(he);
 }
 
-int Mesher::Mve(glm::vec3 p, int v0, Loop *l) {
-	edge_.push_back(new Edge);
-	vertex_.push_back(new Vertex(p));
-	Edge *e_p = edge_.back();
-	int e = edge_.size() - 1;
-	int v1 = vertex_.size() - 1;
+// Gives back a half-edge of NewHalfEdge() called when there were he_size half-edges, in
+// the reverse order of creation.
+void Mesher::ReleaseHalfEdge(int he, int he_size) {
+	if(he < he_size) {
+		DeleteHalfEdge(he);
+		return;
+	}
+	he_next_.pop_back();
+	he_prev_.pop_back();
+	he_twin_.pop_back();
+	he_loop_.pop_back();
+	he_vertex_.pop_back();
+	he_edge_.pop_back();
+}
 
-	HalfEdge *he0 = new HalfEdge(e, v0), *he1 = new HalfEdge(e, v1);
+void Mesher::ReleaseLoop(int l, int loop_size) {
+	if(l < loop_size) free_loop_.push_back(l);
+	else loop_.pop_back();
+}
 
-	e_p->half_edge[0] = he0;
-	e_p->half_edge[1] = he1;
+void Mesher::PopFace() {
+	face_.pop_back();
+	if(face_triangles_.size() > face_.size()) face_triangles_.resize(face_.size());
+	if(face_border_.size() > face_.size()) face_border_.resize(face_.size());
+}
 
-	he0->loop = he1->loop = l;
-	he0->twin = he1;
-	he1->twin = he0;
+void Mesher::PushUndo(UndoEnum op, int n0, int n1, int n2, int n3, int n4, int n5, int n6, int n7) {
+	if(!keep_undo_) return;
+	UndoRecord u = {op, {n0, n1, n2, n3, n4, n5, n6, n7}};
+	undo_.push_back(u);
+}
 
-	he0->next = he1;
-	he1->prev = he0;
-	if(l->half_edge == nullptr) {
-		he1->next = he0;
-		he0->prev = he1;
-		l->half_edge = he0;
-	} else {
-		HalfEdge *he = l->half_edge;
-		while(he->next->vertex != v0) he = he->next;
-		he1->next = he->next;
-		he->next->prev = he1;
-		he0->prev = he;
-		he->next = he0;
-	}
+void Mesher::SetVisible(int f, bool visible) {
+	PushUndo(Undo_Visible, f, face_[f].visualizable);
+	face_[f].visualizable = visible;
+	Touch(f);
+}
 
-	return v1;
+bool Mesher::InLoop(int v, int l) {
+	int he = loop_[l].half_edge;
+	if(he == -1) return false;
+	do {
+		if(v == he_vertex_[he]) return true;
+		he = he_next_[he];
+	} while(he != loop_[l].half_edge);
+	return false;
 }
 
-int Mesher::Mve(glm::vec3 p, int v0, int f) {
-	Loop *l = face_[f]->loop;
+// Loop of face f through v, found by turning around v. Only when v touches several
+// loops of f, the loops are scanned in order.
+int Mesher::FindLoop(int v, int f) {
+	int first = vertex_[v].half_edge;
+	if(first == -1) return face_[f].loop;
+	int l = -1;
+	int he = first;
 	do {
-		if(InLoop(v0, l)) break;
-		l = l->next;
-	} while(l != face_[f]->loop);
-	return Mve(p, v0, l);
-}
-
-void Mesher::Mef(int v0, int v1, Loop *l0) {
-	face_.push_back(new Face);
-	edge_.push_back(new Edge);
-	Face *f1_p = face_.back();
-	int f1 = face_.size() - 1;
-	Edge *e_p = edge_.back();
-	int e = edge_.size() - 1;
+		int l_he = he_loop_[he];
+		if(loop_[l_he].face == f) {
+			if(l != -1 && l != l_he) {
+				l = face_[f].loop;
+				do {
+					if(InLoop(v, l)) break;
+					l = loop_[l].next;
+				} while(l != face_[f].loop);
+				return l;
+			}
+			l = l_he;
+		}
+		he = he_next_[he_twin_[he]];
+	} while(he != first);
+	return l == -1 ? face_[f].loop : l;
+}
 
-	Loop *l1 = new Loop(f1);
-	HalfEdge *he0 = new HalfEdge(e, v0), *he1 = new HalfEdge(e, v1);
+// Half-edge of loop l ending at v. When v is met several times along l, the first
+// one walking from start wins.
+int Mesher::FindIncoming(int v, int l, int start) {
+	int first = vertex_[v].half_edge;
+	int out = -1;
+	int he = first;
+	do {
+		if(he_loop_[he] == l) {
+			if(out != -1) {
+				he = start;
+				while(he_vertex_[he_next_[he]] != v) he = he_next_[he];
+				return he;
+			}
+			out = he;
+		}
+		he = he_next_[he_twin_[he]];
+	} while(he != first);
+	return he_prev_[out];
+}
 
-	f1_p->solid = face_[l0->face]->solid;
-	f1_p->loop = l1;
+void Mesher::AddLoop(int f, int l1) {
+	int l0 = face_[f].loop;
 
-	e_p->half_edge[0] = he0;
-	e_p->half_edge[1] = he1;
+	loop_[l1].next = loop_[l0].next;
+	loop_[l1].prev = l0;
+	loop_[loop_[l0].next].prev = l1;
+	loop_[l0].next = l1;
 
-	he0->loop = l0;
-	he1->loop = l1;
-	he0->twin = he1;
-	he1->twin = he0;
+	loop_[l1].face = f;
+}
+
+void Mesher::SetLoop(int he, int l) {
+	do {
+		he_loop_[he] = l;
+		he = he_next_[he];
+	} while(he != loop_[l].half_edge);
+}
 
-	HalfEdge *he;
+void Mesher::Mvfs(glm::vec3 p) {
+	PushUndo(Undo_Kvfs, loop_.size());
+	int s = solid_.size();
+	int f = face_.size();
+	solid_.push_back(Solid(f));
+	face_.push_back(Face(s, -1));
+	vertex_.push_back(Vertex(p));
+
+	face_[f].loop = NewLoop(f);
+	topology_.vertex++;
+	topology_.face++;
+	topology_.loop++;
+	topology_.solid++;
+}
+
+void Mesher::Reserve(int solid, int face, int loop, int edge, int half_edge, int vertex) {
+	Grow(solid_, solid);
+	Grow(face_, face);
+	Grow(loop_, loop);
+	Grow(edge_, edge);
+	Grow(vertex_, vertex);
+	Grow(he_next_, half_edge);
+	Grow(he_prev_, half_edge);
+	Grow(he_twin_, half_edge);
+	Grow(he_loop_, half_edge);
+	Grow(he_vertex_, half_edge);
+	Grow(he_edge_, half_edge);
+}
+
+// he is the half-edge of l ending at v0 after which the new edge is spliced,
+// -1 when l is still empty.
+int Mesher::MveAt(glm::vec3 p, int v0, int l, int he) {
+	PushUndo(Undo_Kev, he_edge_.size());
+	int e = edge_.size();
+	int v1 = vertex_.size();
+	vertex_.push_back(Vertex(p));
+
+	int he0 = NewHalfEdge(e, v0), he1 = NewHalfEdge(e, v1);
+	edge_.push_back(Edge(he0, he1));
+
+	he_loop_[he0] = he_loop_[he1] = l;
+	he_twin_[he0] = he1;
+	he_twin_[he1] = he0;
+
+	he_next_[he0] = he1;
+	he_prev_[he1] = he0;
+	if(he == -1) {
+		he_next_[he1] = he0;
+		he_prev_[he0] = he1;
+		loop_[l].half_edge = he0;
+	} else {
+		he_next_[he1] = he_next_[he];
+		he_prev_[he_next_[he]] = he1;
+		he_prev_[he0] = he;
+		he_next_[he] = he0;
+	}
+	vertex_[v1].half_edge = he1;
+	if(vertex_[v0].half_edge == -1) vertex_[v0].half_edge = he0;
+	Touch(loop_[l].face);
+	topology_.vertex++;
+	topology_.edge++;
 
-	he = l0->half_edge;
-	while(he->next->vertex != v0) he = he->next;
-	he1->next = he->next;
-	he->next->prev = he1;
-	he0->prev = he;
-	he->next = he0;
+	return v1;
+}
 
-	he = he1->next;
-	while(he->next->vertex != v1) he = he->next;
-	he0->next = he->next;
-	he->next->prev = he0;
-	he1->prev = he;
-	he->next = he1;
+int Mesher::Mve(glm::vec3 p, int v0, int f) {
+	int l = FindLoop(v0, f);
+	int he = loop_[l].half_edge == -1 ? -1 : FindIncoming(v0, l, loop_[l].half_edge);
+	return MveAt(p, v0, l, he);
+}
 
-	l0->half_edge = he0;
-	l1->half_edge = he1;
+// he_v0 and he_v1 are the half-edges of l0 ending at the two vertices to connect.
+// The new face takes the part of l0 from he_v0's successor up to he_v1.
+void Mesher::MefAt(int l0, int he_v0, int he_v1) {
+	PushUndo(Undo_Kef, he_edge_.size(), loop_.size(), loop_[l0].half_edge);
+	int v0 = he_vertex_[he_next_[he_v0]], v1 = he_vertex_[he_next_[he_v1]];
+	int f1 = face_.size();
+	int e = edge_.size();
+	int l1 = NewLoop(f1);
+	face_.push_back(Face(face_[loop_[l0].face].solid, l1));
+
+	int he0 = NewHalfEdge(e, v0), he1 = NewHalfEdge(e, v1);
+	edge_.push_back(Edge(he0, he1));
+
+	he_loop_[he0] = l0;
+	he_loop_[he1] = l1;
+	he_twin_[he0] = he1;
+	he_twin_[he1] = he0;
+
+	he_next_[he1] = he_next_[he_v0];
+	he_prev_[he_next_[he_v0]] = he1;
+	he_prev_[he0] = he_v0;
+	he_next_[he_v0] = he0;
+
+	he_next_[he0] = he_next_[he_v1];
+	he_prev_[he_next_[he_v1]] = he0;
+	he_prev_[he1] = he_v1;
+	he_next_[he_v1] = he1;
+
+	loop_[l0].half_edge = he0;
+	loop_[l1].half_edge = he1;
 
 	SetLoop(he1, l1);
+	Touch(loop_[l0].face);
+	topology_.edge++;
+	topology_.face++;
+	topology_.loop++;
 }
 
 void Mesher::Mef(int v0, int v1, int f0) {
-	Loop *l0 = face_[f0]->loop;
-	do {
-		if(InLoop(v0, l0)) break;
-		l0 = l0->next;
-	} while(l0 != face_[f0]->loop);
-	Mef(v0, v1, l0);
-	face_.back()->visualizable = false;
+	int l0 = FindLoop(v0, f0);
+	int he_v0 = FindIncoming(v0, l0, loop_[l0].half_edge);
+	int he_v1 = FindIncoming(v1, l0, he_next_[he_v0]);
+	MefAt(l0, he_v0, he_v1);
+	SetVisible(face_.size() - 1, false);
 }
 
 void Mesher::KeMr(int e, int f) {
-	Loop *l1 = new Loop(f);
+	int he0 = edge_[e].half_edge[0], he1 = edge_[e].half_edge[1];
+	int v0 = he_vertex_[he0], v1 = he_vertex_[he1];
+	PushUndo(Undo_MeKr, e, f, v0, v1, vertex_[v0].half_edge, vertex_[v1].half_edge,
+		loop_[face_[f].loop].half_edge, loop_.size());
+
+	int l1 = NewLoop(f);
 
-	Loop *l0 = face_[f]->loop;
+	int l0 = face_[f].loop;
 
 	AddLoop(f, l1);
 
-	HalfEdge *he0 = edge_[e]->half_edge[0], *he1 = edge_[e]->half_edge[1];
+	if(vertex_[v0].half_edge == he0)
+		vertex_[v0].half_edge = he_next_[he1] == he0 ? -1 : he_next_[he1];
+	if(vertex_[v1].half_edge == he1)
+		vertex_[v1].half_edge = he_next_[he0] == he1 ? -1 : he_next_[he0];
 
-	he0->prev->next = he1->next;
-	he1->next->prev = he0->prev;
+	he_next_[he_prev_[he0]] = he_next_[he1];
+	he_prev_[he_next_[he1]] = he_prev_[he0];
 
-	he1->prev->next = he0->next;
-	he0->next->prev = he1->prev;
+	he_next_[he_prev_[he1]] = he_next_[he0];
+	he_prev_[he_next_[he0]] = he_prev_[he1];
 
-	l0->half_edge = he0->prev; // outer loop
-	l1->half_edge = he1->prev; // inner loop
+	loop_[l0].half_edge = he_prev_[he0]; // outer loop
+	loop_[l1].half_edge = he_prev_[he1]; // inner loop
 
-	SetLoop(he1->prev, l1);
+	SetLoop(he_prev_[he1], l1);
+	Touch(f);
 
-	delete edge_[e]->half_edge[0];
-	delete edge_[e]->half_edge[1];
-	delete edge_[e]; // edge memory deleted, pointer still in edge list (vector)
-	edge_[e] = nullptr;
+	DeleteHalfEdge(he0);
+	DeleteHalfEdge(he1);
+	edge_[e].half_edge[0] = edge_[e].half_edge[1] = -1; // edge killed, index kept in edge list
+	topology_.edge--;
+	topology_.loop++;
 }
 
 void Mesher::KfMrh(int f0, int f1) {
-	AddLoop(f0, face_[f1]->loop);
-	delete face_[f1];
-	face_[f1] = nullptr;
+	PushUndo(Undo_MfKrh, f0, f1, face_[f1].loop);
+	AddLoop(f0, face_[f1].loop);
+	face_[f1].loop = -1;
+	Touch(f0);
+	Touch(f1);
+	topology_.face--;
+	topology_.hole++;
 }
 
+// The vertical edge of each boundary vertex u is spliced after the twin of the half-edge
+// leaving u, which is the corner Mve would search the twin loop for, and each side face
+// is closed between the tips of consecutive vertical edges.
 void Mesher::Sweep(int f, glm::dvec3 d, double t) {
 	d = glm::normalize(d) * t;
-	Loop *l = face_[f]->loop;
-	int f_outer = l->half_edge->twin->loop->face;
+	int l = face_[f].loop;
+	int f_outer = loop_[he_loop_[he_twin_[loop_[l].half_edge]]].face;
+
+	std::vector<int> ring, ring_begin;
 	do {
-		HalfEdge *he = l->half_edge;
-		Loop *l_twin = he->twin->loop;
-		int v_init = Mve(vertex_[he->vertex]->position + d, he->vertex, l_twin);
-		int v_prev = v_init;
-		he = he->next;
+		ring_begin.push_back(ring.size());
+		int he = loop_[l].half_edge;
 		do {
-			int v_next = Mve(vertex_[he->vertex]->position + d, he->vertex, l_twin);
-			Mef(v_next, v_prev, l_twin);
-			v_prev = v_next;
-			he = he->next;
-		} while(he != l->half_edge);
-		Mef(v_init, v_prev, l_twin);
+			ring.push_back(he);
+			he = he_next_[he];
+		} while(he != loop_[l].half_edge);
+		l = loop_[l].next;
+	} while(l != face_[f].loop);
+	ring_begin.push_back(ring.size());
+	int n = ring.size();
+	Reserve(0, n, n, 2 * n, 4 * n, n);
+
+	for(unsigned int k = 0; k + 1 < ring_begin.size(); k++) {
+		int l_twin = he_loop_[he_twin_[ring[ring_begin[k]]]];
+		int tip_init = -1, he_prev = -1;
+		for(int i = ring_begin[k]; i < ring_begin[k + 1]; i++) {
+			int v = he_vertex_[ring[i]];
+			int w = MveAt(vertex_[v].position + d, v, l_twin, he_twin_[ring[i]]);
+			int he_w = he_prev_[vertex_[w].half_edge]; // vertical half-edge ending at the tip
+			if(i == ring_begin[k]) tip_init = vertex_[w].half_edge;
+			else MefAt(l_twin, he_w, he_prev);
+			he_prev = he_w;
+		}
+		MefAt(l_twin, he_prev_[tip_init], he_prev);
 
-		if(l != face_[f]->loop) KfMrh(f_outer, l_twin->face);
-		l = l->next;
-	} while(l != face_[f]->loop);
-	face_[f_outer]->visualizable = true;
+		if(k > 0) KfMrh(f_outer, loop_[l_twin].face);
+	}
+	SetVisible(f_outer, true);
 }
 
-void Mesher::Build() {
-	for(unsigned int i = 0; i < operator_.size(); i++)
-		operator_[i]->Execute(*this);
+void Mesher::Kvfs(const UndoRecord &u) {
+	int f = face_.size() - 1;
+	ReleaseLoop(face_[f].loop, u.n[0]);
+	vertex_.pop_back();
+	PopFace();
+	solid_.pop_back();
+	topology_.vertex--;
+	topology_.face--;
+	topology_.loop--;
+	topology_.solid--;
+}
 
-	MarkBorder();
+void Mesher::Kev(const UndoRecord &u) {
+	int e = edge_.size() - 1;
+	int he0 = edge_[e].half_edge[0], he1 = edge_[e].half_edge[1];
+	int v0 = he_vertex_[he0], l = he_loop_[he0];
+	if(he_next_[he1] == he0) {
+		loop_[l].half_edge = -1;
+	} else {
+		int he = he_prev_[he0], next = he_next_[he1];
+		he_next_[he] = next;
+		he_prev_[next] = he;
+	}
+	if(vertex_[v0].half_edge == he0) vertex_[v0].half_edge = -1;
+	Touch(loop_[l].face);
+
+	ReleaseHalfEdge(he1, u.n[0]);
+	ReleaseHalfEdge(he0, u.n[0]);
+	edge_.pop_back();
+	vertex_.pop_back();
+	topology_.vertex--;
+	topology_.edge--;
+}
+
+void Mesher::Kef(const UndoRecord &u) {
+	int e = edge_.size() - 1;
+	int he0 = edge_[e].half_edge[0], he1 = edge_[e].half_edge[1];
+	int l0 = he_loop_[he0], l1 = he_loop_[he1];
+	int he = he1;
+	do {
+		he_loop_[he] = l0;
+		he = he_next_[he];
+	} while(he != he1);
+	int he_v0 = he_prev_[he0], he_v1 = he_prev_[he1];
+	int a = he_next_[he1], b = he_next_[he0];
+	he_next_[he_v0] = a;
+	he_prev_[a] = he_v0;
+	he_next_[he_v1] = b;
+	he_prev_[b] = he_v1;
+	loop_[l0].half_edge = u.n[2];
+	Touch(loop_[l0].face);
+
+	ReleaseHalfEdge(he1, u.n[0]);
+	ReleaseHalfEdge(he0, u.n[0]);
+	edge_.pop_back();
+	ReleaseLoop(l1, u.n[1]);
+	PopFace();
+	topology_.edge--;
+	topology_.face--;
+	topology_.loop--;
+}
+
+// The two half-edges are the last ones KeMr freed. The outer and inner loops still start
+// right before them.
+void Mesher::MeKr(const UndoRecord &u) {
+	int e = u.n[0], f = u.n[1], v0 = u.n[2], v1 = u.n[3];
+	int l0 = face_[f].loop, l1 = loop_[l0].next;
+	int he1 = free_half_edge_.back();
+	free_half_edge_.pop_back();
+	int he0 = free_half_edge_.back();
+	free_half_edge_.pop_back();
+
+	int p0 = loop_[l0].half_edge, p1 = loop_[l1].half_edge;
+	int l = he_loop_[p0];
+	int he = p1;
+	do {
+		he_loop_[he] = l;
+		he = he_next_[he];
+	} while(he != p1);
+	int n1 = he_next_[p0], n0 = he_next_[p1];
+	he_vertex_[he0] = v0;
+	he_vertex_[he1] = v1;
+	he_edge_[he0] = he_edge_[he1] = e;
+	he_twin_[he0] = he1;
+	he_twin_[he1] = he0;
+	he_loop_[he0] = he_loop_[he1] = l;
+	he_next_[p0] = he0;
+	he_prev_[he0] = p0;
+	he_next_[he0] = n0;
+	he_prev_[n0] = he0;
+	he_next_[p1] = he1;
+	he_prev_[he1] = p1;
+	he_next_[he1] = n1;
+	he_prev_[n1] = he1;
+	edge_[e].half_edge[0] = he0;
+	edge_[e].half_edge[1] = he1;
+	vertex_[v0].half_edge = u.n[4];
+	vertex_[v1].half_edge = u.n[5];
+	loop_[l0].half_edge = u.n[6];
+
+	loop_[loop_[l1].prev].next = loop_[l1].next;
+	loop_[loop_[l1].next].prev = loop_[l1].prev;
+	ReleaseLoop(l1, u.n[7]);
+	Touch(f);
+	topology_.edge++;
+	topology_.loop--;
+}
+
+void Mesher::MfKrh(const UndoRecord &u) {
+	int f0 = u.n[0], f1 = u.n[1], l = u.n[2];
+	loop_[loop_[l].prev].next = loop_[l].next;
+	loop_[loop_[l].next].prev = loop_[l].prev;
+	loop_[l].prev = loop_[l].next = l;
+	loop_[l].face = f1;
+	face_[f1].loop = l;
+	Touch(f0);
+	Touch(f1);
+	topology_.face++;
+	topology_.hole--;
+}
+
+void Mesher::Revert(const UndoRecord &u) {
+	switch(u.op) {
+	case Undo_Kvfs:
+		Kvfs(u);
+		break;
+	case Undo_Kev:
+		Kev(u);
+		break;
+	case Undo_Kef:
+		Kef(u);
+		break;
+	case Undo_MeKr:
+		MeKr(u);
+		break;
+	case Undo_MfKrh:
+		MfKrh(u);
+		break;
+	case Undo_Visible:
+		face_[u.n[0]].visualizable = u.n[1];
+		Touch(u.n[0]);
+		break;
+	}
 }
 
-GLenum primitive_type;
-void TessBeginCallback(GLenum type) {
-	primitive_type = type;
+void Mesher::StartCheck(Check &check) {
+	check = Check();
+	check.face = face_.size();
+	check.edge = edge_.size();
+	check.vertex = vertex_.size();
+	check.free_loop = free_loop_.size();
+	check.free_half_edge = free_half_edge_.size();
 }
 
-std::vector<glm::vec3> vertex_temp;
-void TessVertexCallback(void *data) {
-	double *vertex = (GLdouble*)data;
-	vertex_temp.push_back(glm::vec3(vertex[0], vertex[1], vertex[2]));
+// Counts what o creates into growth, taking the free slots first as NewLoop() and
+// NewHalfEdge() do, and checks the ids it refers to against what exists once the operators
+// checked before have run. What a Sweep creates depends on the size of the face it sweeps,
+// so it reserves for itself when it runs; past one the counts are lower bounds and ids
+// beyond them go unchecked.
+bool Mesher::CheckOperator(Check &check, const Operator &o, Count &growth, std::string &error) {
+	auto VertexExists = [&](int v) {
+		if(v < 0 || (check.exact && v >= check.vertex)) error = "v" + std::to_string(v) + " does not exist";
+		return error.empty();
+	};
+	auto FaceAlive = [&](int f) {
+		if(f < 0 || (check.exact && f >= check.face)) error = "f" + std::to_string(f) + " does not exist";
+		else if((f < (int)face_.size() && face_[f].loop == -1) || check.face_killed.count(f))
+			error = "f" + std::to_string(f) + " is killed";
+		return error.empty();
+	};
+	auto EdgeAlive = [&](int e) {
+		if(e < 0 || (check.exact && e >= check.edge)) error = "e" + std::to_string(e) + " does not exist";
+		else if((e < (int)edge_.size() && edge_[e].half_edge[0] == -1) || check.edge_killed.count(e))
+			error = "e" + std::to_string(e) + " is killed";
+		return error.empty();
+	};
+	auto NewLoop = [&]() {
+		if(check.free_loop) check.free_loop--;
+		else growth.loop++;
+	};
+	auto NewEdge = [&]() {
+		check.edge++;
+		growth.edge++;
+		int reused = std::min(check.free_half_edge, 2);
+		check.free_half_edge -= reused;
+		growth.half_edge += 2 - reused;
+	};
+
+	error.clear();
+	switch(o.op) {
+	case Euler_Mvfs:
+		growth.solid++;
+		check.face++;
+		growth.face++;
+		check.vertex++;
+		growth.vertex++;
+		NewLoop();
+		break;
+	case Euler_Mve:
+		if(!VertexExists(o.n[0]) || !FaceAlive(o.n[1])) break;
+		check.vertex++;
+		growth.vertex++;
+		NewEdge();
+		break;
+	case Euler_Mef:
+		if(!VertexExists(o.n[0]) || !VertexExists(o.n[1]) || !FaceAlive(o.n[2])) break;
+		check.face++;
+		growth.face++;
+		NewLoop();
+		NewEdge();
+		break;
+	case Euler_KeMr:
+		if(!EdgeAlive(o.n[0]) || !FaceAlive(o.n[1])) break;
+		check.edge_killed.insert(o.n[0]);
+		check.free_half_edge += 2;
+		NewLoop();
+		break;
+	case Euler_KfMrh:
+		if(!FaceAlive(o.n[0]) || !FaceAlive(o.n[1])) break;
+		if(o.n[0] == o.n[1]) error = "a face cannot be a hole of itself";
+		check.face_killed.insert(o.n[1]);
+		break;
+	case Op_Sweep:
+		if(!FaceAlive(o.n[0])) break;
+		check.exact = false;
+		check.free_loop = check.free_half_edge = 0;
+		break;
+	}
+	return error.empty();
 }
 
-std::vector<glm::vec3> triangle_vertex;
-void TessEndCallback() {
-	if(primitive_type == GL_TRIANGLE_FAN) {
-		for(unsigned int i = 1; i < vertex_temp.size() - 1; i++) {
-			triangle_vertex.push_back(vertex_temp[0]);
-			triangle_vertex.push_back(vertex_temp[i]);
-			triangle_vertex.push_back(vertex_temp[i + 1]);
+// Checks what CheckOperator() cannot see ahead, against the kernel o is about to run in.
+// KeMr has to split one loop of its face in two non-empty ones.
+bool Mesher::CheckKernel(const Operator &o, std::string &error) {
+	error.clear();
+	if(o.op == Euler_KeMr) {
+		int he0 = edge_[o.n[0]].half_edge[0], he1 = edge_[o.n[0]].half_edge[1];
+		if(he_loop_[he0] != he_loop_[he1] || loop_[he_loop_[he0]].face != o.n[1])
+			error = "e" + std::to_string(o.n[0]) + " is not on one loop of f" + std::to_string(o.n[1]);
+		else if(he_next_[he0] == he1 || he_next_[he1] == he0)
+			error = "e" + std::to_string(o.n[0]) + " would leave an empty loop";
+	}
+	return error.empty();
+}
+
+// Checks the operators from built_ on and counts what they create.
+bool Mesher::DryRun(Count &growth, bool report) {
+	Check check;
+	StartCheck(check);
+	std::string error;
+	for(unsigned int i = built_; i < operator_.size(); i++)
+		if(!CheckOperator(check, operator_[i], growth, error)) {
+			if(report) std::cerr << "operator " << i << " (" << ToString(operator_[i]) << "): " << error << std::endl;
+			return false;
 		}
-	} else if(primitive_type == GL_TRIANGLE_STRIP) {
-		triangle_vertex.push_back(vertex_temp[0]);
-		triangle_vertex.push_back(vertex_temp[1]);
-		triangle_vertex.push_back(vertex_temp[2]);
-		glm::vec3 v = glm::cross(
-			vertex_temp[2] - vertex_temp[1],
-			vertex_temp[1] - vertex_temp[0]);
-		for(unsigned int i = 1; i < vertex_temp.size() - 2; i++)
-			if(glm::dot(v, glm::cross(
-				vertex_temp[i + 2] - vertex_temp[i + 1],
-				vertex_temp[i + 1] - vertex_temp[i + 0])) > 0) {
-				triangle_vertex.push_back(vertex_temp[i + 0]);
-				triangle_vertex.push_back(vertex_temp[i + 1]);
-				triangle_vertex.push_back(vertex_temp[i + 2]);
-			} else {
-				triangle_vertex.push_back(vertex_temp[i + 0]);
-				triangle_vertex.push_back(vertex_temp[i + 2]);
-				triangle_vertex.push_back(vertex_temp[i + 1]);
+	return true;
+}
+
+// Runs the operators from built_ to end. The ones after a Sweep, which DryRun() could not
+// check, are checked as they come against the kernel the Sweep left; swept tells that one
+// ran since the last DryRun(). Stops before the first bad one.
+bool Mesher::Run(unsigned int end, bool swept, bool report) {
+	Check check;
+	if(swept) StartCheck(check);
+	Count growth;
+	std::string error;
+	while(built_ < end) {
+		const Operator &o = operator_[built_];
+		if((swept && !CheckOperator(check, o, growth, error)) || !CheckKernel(o, error)) {
+			if(report) std::cerr << "operator " << built_ << " (" << ToString(o) << "): " << error << std::endl;
+			return false;
+		}
+		if(keep_undo_) undo_mark_.push_back(std::make_pair(built_, (unsigned int)undo_.size()));
+		Execute(o);
+		built_++;
+		if(o.op == Op_Sweep) {
+			swept = true;
+			StartCheck(check);
+		}
+		if(snapshot_interval_ && built_ % snapshot_interval_ == 0
+			&& (snapshot_.empty() || snapshot_.back().built < built_))
+			TakeSnapshot();
+	}
+	return true;
+}
+
+// Cuts the operators from built_ on before each Mvfs. The first face and vertex of a part
+// are the first ones its operators refer to, as a valid log can only refer to those of its
+// Mvfs until it makes more; the first edge follows since every edge comes with one vertex
+// or one face, and Mvfs makes one of each and no edge. A part whose offsets cannot be told
+// or that refers below them joins the one before. The first part goes on from the current
+// kernel and is built in it.
+void Mesher::SplitParts(std::vector<Part> &part) {
+	const Part base = {built_, built_, (int)solid_.size(), (int)face_.size(), (int)edge_.size(), (int)vertex_.size()};
+	part.assign(1, base);
+	int solid = base.solid;
+	unsigned int i = built_;
+	while(i < operator_.size() && operator_[i].op != Euler_Mvfs)
+		i++;
+	part[0].end = i;
+	while(i < operator_.size()) {
+		Part p = {i, i + 1, solid++, -1, -1, -1};
+		int min_face = INT_MAX, min_vertex = INT_MAX, min_edge = INT_MAX;
+		bool swept = false;
+		for(; p.end < operator_.size() && operator_[p.end].op != Euler_Mvfs; p.end++) {
+			const Operator &o = operator_[p.end];
+			int face = INT_MAX, vertex = INT_MAX, edge = INT_MAX;
+			switch(o.op) {
+			case Euler_Mve:
+				vertex = o.n[0];
+				face = o.n[1];
+				break;
+			case Euler_Mef:
+				vertex = std::min(o.n[0], o.n[1]);
+				face = o.n[2];
+				break;
+			case Euler_KeMr:
+				edge = o.n[0];
+				face = o.n[1];
+				break;
+			case Euler_KfMrh:
+				face = std::min(o.n[0], o.n[1]);
+				break;
+			case Op_Sweep:
+				face = o.n[0];
+				break;
 			}
-	} else {
-		triangle_vertex += vertex_temp;
+			if(p.face == -1 && face != INT_MAX) p.face = face;
+			if(p.vertex == -1 && vertex != INT_MAX && !swept) p.vertex = vertex;
+			swept = swept || o.op == Op_Sweep;
+			min_face = std::min(min_face, face);
+			min_vertex = std::min(min_vertex, vertex);
+			min_edge = std::min(min_edge, edge);
+		}
+		i = p.end;
+		if(p.face != -1 && p.vertex != -1) {
+			p.edge = base.edge + (p.face - base.face) + (p.vertex - base.vertex) - 2 * (p.solid - base.solid);
+			if(min_face >= p.face && min_vertex >= p.vertex && min_edge >= p.edge) {
+				part.push_back(p);
+				continue;
+			}
+		}
+		part.back().end = p.end;
+		while(part.size() > 1 && (min_face < part.back().face || min_vertex < part.back().vertex
+			|| min_edge < part.back().edge)) {
+			part[part.size() - 2].end = part.back().end;
+			part.pop_back();
+		}
 	}
-	vertex_temp.clear();
 }
 
-std::vector<glm::vec3> Mesher::TriangulateFace(int f) {
-	triangle_vertex.clear();
-	if(!face_[f]) return std::move(triangle_vertex);
-
-	GLUtesselator *tess = gluNewTess();
-	gluTessCallback(tess, GLU_TESS_BEGIN, (void(CALLBACK*)())TessBeginCallback);
-	gluTessCallback(tess, GLU_TESS_VERTEX, (void(CALLBACK*)())TessVertexCallback);
-	gluTessCallback(tess, GLU_TESS_END, (void(CALLBACK*)())TessEndCallback);
-	gluTessBeginPolygon(tess, 0);
-	Loop *l = face_[f]->loop;
-	do {
-		gluTessBeginContour(tess);
-		HalfEdge *he = l->half_edge;
-		do {
-			double *p = (double*)&vertex_[he->vertex]->position;
-			gluTessVertex(tess, p, p);
-			he = he->next;
-		} while(he != l->half_edge);
-		l = l->next;
-		gluTessEndContour(tess);
-	} while(l != face_[f]->loop);
-	gluTessEndPolygon(tess);
-	gluDeleteTess(tess);
+// The parts after the first are built each in a kernel of its own, then copied in where
+// their offsets say. One that would not land there, which takes a log referring across
+// solids in a way SplitParts() cannot see, is run again in order with all after it.
+bool Mesher::BuildParts(const std::vector<Part> &part, unsigned int thread_count) {
+	std::vector<Mesher> kernel(part.size());
+	std::vector<char> built(part.size(), false);
+	ParallelFor(part.size() - 1, thread_count, [&](unsigned int, int i) {
+		const Part &p = part[i + 1];
+		Mesher &m = kernel[i + 1];
+		m.operator_.assign(operator_.begin() + p.begin, operator_.begin() + p.end);
+		for(auto &o: m.operator_)
+			switch(o.op) {
+			case Euler_Mve:
+				o.n[0] -= p.vertex;
+				o.n[1] -= p.face;
+				break;
+			case Euler_Mef:
+				o.n[0] -= p.vertex;
+				o.n[1] -= p.vertex;
+				o.n[2] -= p.face;
+				break;
+			case Euler_KeMr:
+				o.n[0] -= p.edge;
+				o.n[1] -= p.face;
+				break;
+			case Euler_KfMrh:
+				o.n[0] -= p.face;
+				o.n[1] -= p.face;
+				break;
+			case Op_Sweep:
+				o.n[0] -= p.face;
+				break;
+			}
+		Count growth;
+		if(!m.DryRun(growth, false)) return;
+		m.Reserve(growth.solid, growth.face, growth.loop, growth.edge, growth.half_edge, growth.vertex);
+		if(!m.Run(m.operator_.size(), false, false)) return;
+		m.UpdateBorder();
+		built[i + 1] = true;
+	});
+
+	Count size;
+	size.solid = solid_.size();
+	size.face = face_.size();
+	size.loop = loop_.size();
+	size.edge = edge_.size();
+	size.half_edge = he_edge_.size();
+	size.vertex = vertex_.size();
+	std::vector<Count> at(part.size());
+	unsigned int n = 1;
+	for(; n < part.size(); n++) {
+		const Part &p = part[n];
+		const Mesher &m = kernel[n];
+		if(!built[n] || size.solid != p.solid || size.face != p.face || size.edge != p.edge || size.vertex != p.vertex)
+			break;
+		at[n] = size;
+		size.solid += m.solid_.size();
+		size.face += m.face_.size();
+		size.loop += m.loop_.size();
+		size.edge += m.edge_.size();
+		size.half_edge += m.he_edge_.size();
+		size.vertex += m.vertex_.size();
+	}
+
+	UpdateBorder(); // the border flags of the parts are already set by their own Build()
+	solid_.resize(size.solid, Solid(-1));
+	face_.resize(size.face, Face(-1, -1));
+	loop_.resize(size.loop, Loop(-1, -1));
+	edge_.resize(size.edge, Edge(-1, -1));
+	vertex_.resize(size.vertex, Vertex(glm::dvec3(0)));
+	he_next_.resize(size.half_edge);
+	he_prev_.resize(size.half_edge);
+	he_twin_.resize(size.half_edge);
+	he_loop_.resize(size.half_edge);
+	he_vertex_.resize(size.half_edge);
+	he_edge_.resize(size.half_edge);
+	face_border_.resize(size.face, false);
+	ParallelFor(n - 1, thread_count, [&](unsigned int, int i) {
+		Place(kernel[i + 1], at[i + 1]);
+	});
+	for(unsigned int i = 1; i < n; i++) {
+		for(int l: kernel[i].free_loop_)
+			free_loop_.push_back(l + at[i].loop);
+		for(int he: kernel[i].free_half_edge_)
+			free_half_edge_.push_back(he + at[i].half_edge);
+		const Topology &t = kernel[i].topology_;
+		topology_.vertex += t.vertex;
+		topology_.edge += t.edge;
+		topology_.face += t.face;
+		topology_.loop += t.loop;
+		topology_.solid += t.solid;
+		topology_.hole += t.hole;
+	}
 
-	return std::move(triangle_vertex);
+	// the parts before may have swept
+	built_ = part[n - 1].end;
+	return Run(operator_.size(), true);
 }
 
-std::vector<glm::vec3> &Mesher::Triangulate() {
+// Copies the entities of m to the slots from at on, shifting the ids they hold to match.
+void Mesher::Place(const Mesher &m, const Count &at) {
+	auto Shift = [](int i, int offset) {
+		return i == -1 ? -1 : i + offset;
+	};
+	for(unsigned int i = 0; i < m.solid_.size(); i++) {
+		Solid s = m.solid_[i];
+		s.face = Shift(s.face, at.face);
+		solid_[at.solid + i] = s;
+	}
+	for(unsigned int i = 0; i < m.face_.size(); i++) {
+		Face f = m.face_[i];
+		f.solid = Shift(f.solid, at.solid);
+		f.loop = Shift(f.loop, at.loop);
+		face_[at.face + i] = f;
+	}
+	for(unsigned int i = 0; i < m.loop_.size(); i++) {
+		Loop l = m.loop_[i];
+		l.face = Shift(l.face, at.face);
+		l.prev = Shift(l.prev, at.loop);
+		l.next = Shift(l.next, at.loop);
+		l.half_edge = Shift(l.half_edge, at.half_edge);
+		loop_[at.loop + i] = l;
+	}
+	for(unsigned int i = 0; i < m.edge_.size(); i++) {
+		Edge e = m.edge_[i];
+		e.half_edge[0] = Shift(e.half_edge[0], at.half_edge);
+		e.half_edge[1] = Shift(e.half_edge[1], at.half_edge);
+		edge_[at.edge + i] = e;
+	}
+	for(unsigned int i = 0; i < m.vertex_.size(); i++) {
+		Vertex v = m.vertex_[i];
+		v.half_edge = Shift(v.half_edge, at.half_edge);
+		vertex_[at.vertex + i] = v;
+	}
+	for(unsigned int i = 0; i < m.he_edge_.size(); i++) {
+		int he = at.half_edge + i;
+		he_next_[he] = Shift(m.he_next_[i], at.half_edge);
+		he_prev_[he] = Shift(m.he_prev_[i], at.half_edge);
+		he_twin_[he] = Shift(m.he_twin_[i], at.half_edge);
+		he_loop_[he] = Shift(m.he_loop_[i], at.loop);
+		he_vertex_[he] = Shift(m.he_vertex_[i], at.vertex);
+		he_edge_[he] = Shift(m.he_edge_[i], at.edge);
+	}
+}
+
+bool Mesher::Build(unsigned int thread_count) {
+	Count growth;
+	if(!DryRun(growth)) return false;
+	Reserve(growth.solid, growth.face, growth.loop, growth.edge, growth.half_edge, growth.vertex);
+	std::vector<Part> part;
+	if(ThreadCount(thread_count) > 1 && !keep_undo_ && !snapshot_interval_) {
+		SplitParts(part);
+		// a kernel per solid costs more than small solids save, so runs of parts are
+		// merged into a few per thread
+		unsigned int size = (operator_.size() - part[0].end) / (4 * ThreadCount(thread_count)) + 1;
+		unsigned int n = 1;
+		for(unsigned int i = 1; i < part.size(); i++)
+			if(n > 1 && part[n - 1].end - part[n - 1].begin < size) part[n - 1].end = part[i].end;
+			else part[n++] = part[i];
+		part.resize(n);
+		if(part.size() < 3) part.clear(); // a single part gains nothing from a kernel of its own
+	}
+	unsigned int end = part.empty() ? operator_.size() : part[0].end;
+	bool ok = Run(end, false);
+	if(ok && part.size() > 1) ok = BuildParts(part, thread_count);
+
+	UpdateBorder();
+	return ok;
+}
+
+bool Mesher::Undo() {
+	if(undo_mark_.empty() || built_ != operator_.size() || undo_mark_.back().first + 1 != built_)
+		return false;
+	while(undo_.size() > undo_mark_.back().second) {
+		Revert(undo_.back());
+		undo_.pop_back();
+	}
+	undo_mark_.pop_back();
+	redo_.push_back(operator_.back());
+	operator_.pop_back();
+	built_--;
+	while(!snapshot_.empty() && snapshot_.back().built > built_)
+		snapshot_.pop_back();
+
+	UpdateBorder();
+	return true;
+}
+
+bool Mesher::Redo() {
+	if(redo_.empty() || built_ != operator_.size()) return false;
+	operator_.push_back(redo_.back());
+	redo_.pop_back();
+	return Build();
+}
+
+void Mesher::TakeSnapshot() {
+	const Snapshot *p = snapshot_.empty() ? nullptr : &snapshot_.back();
+	Snapshot s;
+	s.built = built_;
+	s.solid.Store(solid_, p ? &p->solid : nullptr);
+	s.face.Store(face_, p ? &p->face : nullptr);
+	s.loop.Store(loop_, p ? &p->loop : nullptr);
+	s.edge.Store(edge_, p ? &p->edge : nullptr);
+	s.vertex.Store(vertex_, p ? &p->vertex : nullptr);
+	s.he_next.Store(he_next_, p ? &p->he_next : nullptr);
+	s.he_prev.Store(he_prev_, p ? &p->he_prev : nullptr);
+	s.he_twin.Store(he_twin_, p ? &p->he_twin : nullptr);
+	s.he_loop.Store(he_loop_, p ? &p->he_loop : nullptr);
+	s.he_vertex.Store(he_vertex_, p ? &p->he_vertex : nullptr);
+	s.he_edge.Store(he_edge_, p ? &p->he_edge : nullptr);
+	s.free_loop.Store(free_loop_, p ? &p->free_loop : nullptr);
+	s.free_half_edge.Store(free_half_edge_, p ? &p->free_half_edge : nullptr);
+	s.topology = topology_;
+	snapshot_.push_back(std::move(s));
+}
+
+void Mesher::RestoreSnapshot(const Snapshot &s) {
+	built_ = s.built;
+	s.solid.Load(solid_);
+	s.face.Load(face_);
+	s.loop.Load(loop_);
+	s.edge.Load(edge_);
+	s.vertex.Load(vertex_);
+	s.he_next.Load(he_next_);
+	s.he_prev.Load(he_prev_);
+	s.he_twin.Load(he_twin_);
+	s.he_loop.Load(he_loop_);
+	s.he_vertex.Load(he_vertex_);
+	s.he_edge.Load(he_edge_);
+	s.free_loop.Load(free_loop_);
+	s.free_half_edge.Load(free_half_edge_);
+	topology_ = s.topology;
+}
+
+// The border flags stored in the snapshots may be stale since they are only updated at the
+// end of Build(), so they are recomputed; every face is triangulated again.
+void Mesher::Seek(unsigned int k) {
+	k = std::min(k, (unsigned int)operator_.size());
+	int s = (int)snapshot_.size() - 1;
+	while(s >= 0 && snapshot_[s].built > k)
+		s--;
+	unsigned int from = s >= 0 ? snapshot_[s].built : 0;
+	if(built_ > k || built_ < from) {
+		ClearKernel();
+		built_ = 0;
+		if(s >= 0) RestoreSnapshot(snapshot_[s]);
+	}
+	for(auto &t: face_triangles_)
+		t.dirty = true;
+
+	while(built_ < k)
+		Execute(operator_[built_++]);
+	undo_.clear();
+	undo_mark_.clear();
+	MarkBorder();
+	face_border_.assign(face_.size(), false);
+	border_face_.clear();
+}
+
+void Mesher::ClearKernel() {
+	solid_.clear();
+	face_.clear();
+	loop_.clear();
+	edge_.clear();
+	vertex_.clear();
+
+	he_next_.clear();
+	he_prev_.clear();
+	he_twin_.clear();
+	he_loop_.clear();
+	he_vertex_.clear();
+	he_edge_.clear();
+
+	free_loop_.clear();
+	free_half_edge_.clear();
+	topology_ = Topology();
+}
+
+void Mesher::Clear() {
+	ClearKernel();
+
 	triangel_vertex_.clear();
+	triangel_normal_.clear();
+	triangel_valid_ = false;
+	mesh_vertex_.clear();
+	mesh_normal_.clear();
+	mesh_index_.clear();
+	face_triangles_.clear();
+
+	built_ = 0;
+	face_border_.clear();
+	border_face_.clear();
+	snapshot_.clear();
+	undo_.clear();
+	undo_mark_.clear();
+	redo_.clear();
+}
+
+Remap Mesher::Compact() {
+	snapshot_.clear();
+	undo_.clear();
+	undo_mark_.clear();
+	redo_.clear();
+	Remap remap;
+	std::vector<int> loop_remap(loop_.size(), 0), he_remap(he_edge_.size(), 0);
+	for(int l: free_loop_) loop_remap[l] = -1;
+	for(int he: free_half_edge_) he_remap[he] = -1;
+
+	int n;
+	n = 0;
+	remap.solid.resize(solid_.size());
+	for(auto &s: remap.solid) s = n++;
+	n = 0;
+	remap.face.resize(face_.size());
 	for(unsigned int i = 0; i < face_.size(); i++)
-		if(face_[i] && face_[i]->visualizable)
-			triangel_vertex_ += TriangulateFace(i);
+		remap.face[i] = face_[i].loop == -1 ? -1 : n++;
+	n = 0;
+	remap.edge.resize(edge_.size());
+	for(unsigned int i = 0; i < edge_.size(); i++)
+		remap.edge[i] = edge_[i].half_edge[0] == -1 ? -1 : n++;
+	n = 0;
+	remap.vertex.resize(vertex_.size());
+	for(auto &v: remap.vertex) v = n++;
+	n = 0;
+	for(auto &l: loop_remap) if(l != -1) l = n++;
+	n = 0;
+	for(auto &he: he_remap) if(he != -1) he = n++;
+
+	for(unsigned int i = 0; i < face_.size(); i++) // a solid whose first face was killed keeps another live one
+		if(face_[i].loop != -1 && remap.face[solid_[face_[i].solid].face] == -1)
+			solid_[face_[i].solid].face = i;
+
+	Pack(solid_, remap.solid);
+	Pack(face_, remap.face);
+	if(!face_triangles_.empty()) { // killed faces have no triangles, the layout keeps its order
+		face_triangles_.resize(remap.face.size());
+		Pack(face_triangles_, remap.face);
+	}
+	if(!face_border_.empty()) {
+		for(int f = face_border_.size(); f < (int)remap.face.size(); f++)
+			border_face_.push_back(f);
+		face_border_.resize(remap.face.size(), true);
+		Pack(face_border_, remap.face);
+		int n = 0;
+		for(int f: border_face_)
+			if(remap.face[f] != -1) border_face_[n++] = remap.face[f];
+		border_face_.resize(n);
+	}
+	Pack(loop_, loop_remap);
+	Pack(edge_, remap.edge);
+	Pack(vertex_, remap.vertex);
+	Pack(he_next_, he_remap);
+	Pack(he_prev_, he_remap);
+	Pack(he_twin_, he_remap);
+	Pack(he_loop_, he_remap);
+	Pack(he_vertex_, he_remap);
+	Pack(he_edge_, he_remap);
+	free_loop_.clear();
+	free_half_edge_.clear();
+
+	for(auto &s: solid_)
+		s.face = remap.face[s.face];
+	for(auto &f: face_) {
+		f.solid = remap.solid[f.solid];
+		f.loop = loop_remap[f.loop];
+	}
+	for(auto &l: loop_) {
+		l.face = remap.face[l.face];
+		l.prev = loop_remap[l.prev];
+		l.next = loop_remap[l.next];
+		l.half_edge = Remapped(he_remap, l.half_edge);
+	}
+	for(auto &e: edge_)
+		for(auto &he: e.half_edge)
+			he = he_remap[he];
+	for(auto &v: vertex_)
+		v.half_edge = Remapped(he_remap, v.half_edge);
+	for(unsigned int i = 0; i < he_edge_.size(); i++) {
+		he_next_[i] = he_remap[he_next_[i]];
+		he_prev_[i] = he_remap[he_prev_[i]];
+		he_twin_[i] = he_remap[he_twin_[i]];
+		he_loop_[i] = loop_remap[he_loop_[i]];
+		he_vertex_[i] = remap.vertex[he_vertex_[i]];
+		he_edge_[i] = remap.edge[he_edge_[i]];
+	}
+
+	return remap;
+}
+
+int Mesher::TriangleCount(int f, int &vertex_count) {
+	int contour_count = 0;
+	vertex_count = 0;
+	int l = face_[f].loop;
+	do {
+		int he = loop_[l].half_edge;
+		if(he != -1) {
+			do {
+				vertex_count++;
+				he = he_next_[he];
+			} while(he != loop_[l].half_edge);
+			contour_count++;
+		}
+		l = loop_[l].next;
+	} while(l != face_[f].loop);
+	return Triangulator::TriangleCount(vertex_count, contour_count);
+}
+
+// Newell's normal is the exact area vector of a planar loop and a least-squares one of a
+// warped loop, the plane goes through the mean of its vertices. The outer loop is the
+// largest one, KeMr may leave a hole first in the face's ring.
+void Mesher::UpdatePlane(int f) {
+	Face &face = face_[f];
+	double length_max = -1;
+	int l = face.loop, i = 0;
+	do {
+		glm::dvec3 n(0), c(0);
+		int he = loop_[l].half_edge, count = 0;
+		if(he != -1)
+			do {
+				const glm::dvec3 &p = vertex_[he_vertex_[he]].position, &q = vertex_[he_vertex_[he_next_[he]]].position;
+				n.x += (p.y - q.y) * (p.z + q.z);
+				n.y += (p.z - q.z) * (p.x + q.x);
+				n.z += (p.x - q.x) * (p.y + q.y);
+				c += p;
+				count++;
+				he = he_next_[he];
+			} while(he != loop_[l].half_edge);
+		if(glm::dot(n, n) > length_max) {
+			length_max = glm::dot(n, n);
+			face.normal = glm::normalize(n);
+			face.offset = count ? -glm::dot(face.normal, c / (double)count) : 0;
+			face.outer = i;
+		}
+		l = loop_[l].next;
+		i++;
+	} while(l != face.loop);
+}
+
+std::vector<glm::vec3> Mesher::TriangulateFace(int f) {
+	std::vector<glm::vec3> triangle_vertex;
+	if(face_[f].loop == -1) return triangle_vertex;
+
+	UpdatePlane(f);
+	Triangulator triangulator;
+	for(int i: TriangulateFace(f, triangulator))
+		triangle_vertex.push_back(glm::vec3(triangulator.position(i)));
+	return triangle_vertex;
+}
+
+// The face's vertices are left in the triangulator, in loop order. Gives exactly
+// TriangleCount(f) triangles. The outer loop of the cached plane is projected along it.
+const std::vector<int> &Mesher::TriangulateFace(int f, Triangulator &triangulator) {
+	triangulator.Clear();
+	int l = face_[f].loop;
+	do {
+		int he = loop_[l].half_edge;
+		if(he != -1)
+			do {
+				triangulator.AddVertex(vertex_[he_vertex_[he]].position);
+				he = he_next_[he];
+			} while(he != loop_[l].half_edge);
+		triangulator.CloseContour();
+		l = loop_[l].next;
+	} while(l != face_[f].loop);
+
+	return triangulator.Triangulate(&face_[f].normal, face_[f].outer);
+}
+
+// Every face knows its triangle and vertex counts before it is triangulated, so the faces
+// are laid out in the outputs by prefix sums and then filled independently. Clean faces
+// ahead of the first change of layout stay where they are, the ones after it are moved.
+void Mesher::Triangulate(unsigned int thread_count) {
+	int n = face_.size();
+	face_triangles_.resize(n);
+
+	std::vector<FaceTriangles> layout(n);
+	int end = 0, vertex_end = 0, first = n;
+	for(int f = 0; f < n; f++) {
+		const FaceTriangles &old = face_triangles_[f];
+		FaceTriangles &t = layout[f];
+		if(face_[f].loop != -1 && face_[f].visualizable) {
+			if(old.dirty) {
+				t.count = TriangleCount(f, t.vertex_count) * 3;
+				if(!t.count) t.vertex_count = 0; // a wire face has nothing to draw
+			} else {
+				t.count = old.count;
+				t.vertex_count = old.vertex_count;
+			}
+		}
+		t.offset = end;
+		t.vertex_offset = vertex_end;
+		t.dirty = false;
+		end += t.count;
+		vertex_end += t.vertex_count;
+		if(first == n && (t.offset != old.offset || t.count != old.count
+			|| t.vertex_offset != old.vertex_offset || t.vertex_count != old.vertex_count))
+			first = f;
+	}
+	int begin = first < n ? layout[first].offset : end;
+	int vertex_begin = first < n ? layout[first].vertex_offset : vertex_end;
+
+	std::vector<uint32_t> index_moved(mesh_index_.begin() + begin, mesh_index_.end());
+	std::vector<glm::vec3> mesh_vertex_moved(mesh_vertex_.begin() + vertex_begin, mesh_vertex_.end());
+	std::vector<glm::vec3> mesh_normal_moved(mesh_normal_.begin() + vertex_begin, mesh_normal_.end());
+	mesh_index_.resize(end);
+	mesh_vertex_.resize(vertex_end);
+	mesh_normal_.resize(vertex_end);
+
+	std::vector<int> face;
+	for(int f = 0; f < n; f++)
+		if(layout[f].count && (face_triangles_[f].dirty || f >= first)) face.push_back(f);
+	std::vector<Triangulator> triangulator(ThreadCount(thread_count));
+	ParallelFor(face.size(), thread_count, [&](unsigned int thread, int i) {
+		int f = face[i];
+		const FaceTriangles &old = face_triangles_[f], &t = layout[f];
+		uint32_t *index = &mesh_index_[t.offset];
+		glm::vec3 *mesh_vertex = &mesh_vertex_[t.vertex_offset], *mesh_normal = &mesh_normal_[t.vertex_offset];
+		if(!old.dirty) {
+			for(int j = 0; j < t.count; j++)
+				index[j] = index_moved[old.offset - begin + j] - old.vertex_offset + t.vertex_offset;
+			std::copy_n(&mesh_vertex_moved[old.vertex_offset - vertex_begin], t.vertex_count, mesh_vertex);
+			std::copy_n(&mesh_normal_moved[old.vertex_offset - vertex_begin], t.vertex_count, mesh_normal);
+			return;
+		}
 
-	triangel_normal_.resize(triangel_vertex_.size());
-	for(unsigned int i = 0; i < triangel_normal_.size(); i += 3)
-		triangel_normal_[i + 0] =
-		triangel_normal_[i + 1] =
-		triangel_normal_[i + 2] = glm::normalize(glm::cross(
-			triangel_vertex_[i + 1] - triangel_vertex_[i + 0],
-			triangel_vertex_[i + 2] - triangel_vertex_[i + 1]));
+		// all the triangles of a face lie in its plane
+		UpdatePlane(f);
+		Triangulator &tri = triangulator[thread];
+		const std::vector<int> &triangle = TriangulateFace(f, tri);
+		// each vertex is converted once, the triangles pick the floats
+		ToFloat(&tri.position()[0].x, &mesh_vertex[0].x, 3 * t.vertex_count);
+		for(int j = 0; j < t.count; j++)
+			index[j] = t.vertex_offset + triangle[j];
+		std::fill_n(mesh_normal, t.vertex_count, glm::vec3(face_[f].normal));
+	});
+
+	face_triangles_.swap(layout);
+	triangel_valid_ = false;
+}
 
+void Mesher::ExpandTriangles() {
+	triangel_vertex_.resize(mesh_index_.size());
+	triangel_normal_.resize(mesh_index_.size());
+	for(size_t j = 0; j < mesh_index_.size(); j++) {
+		triangel_vertex_[j] = mesh_vertex_[mesh_index_[j]];
+		triangel_normal_[j] = mesh_normal_[mesh_index_[j]];
+	}
+	triangel_valid_ = true;
+}
+
+std::vector<glm::vec3> &Mesher::triangel_vertex() {
+	if(!triangel_valid_) ExpandTriangles();
 	return triangel_vertex_;
 }
 
+std::vector<glm::vec3> &Mesher::triangel_normal() {
+	if(!triangel_valid_) ExpandTriangles();
+	return triangel_normal_;
+}
+
+void Mesher::OptimizeVertexCache(unsigned int cache_size, unsigned int thread_count) {
+	std::vector<VertexCache> optimizer(ThreadCount(thread_count));
+	std::vector<std::vector<glm::vec3>> moved(optimizer.size());
+	ParallelFor(face_triangles_.size(), thread_count, [&](unsigned int thread, int f) {
+		const FaceTriangles &t = face_triangles_[f];
+		// a face the cache holds whole loads each vertex once in any order
+		if(t.vertex_count <= (int)cache_size) return;
+		uint32_t *index = &mesh_index_[t.offset];
+		for(int j = 0; j < t.count; j++)
+			index[j] -= t.vertex_offset;
+		VertexCache &o = optimizer[thread];
+		o.Optimize(index, t.count / 3, t.vertex_count, cache_size);
+		const std::vector<int> &remap = o.remap();
+
+		std::vector<glm::vec3> &m = moved[thread];
+		glm::vec3 *mesh_vertex = &mesh_vertex_[t.vertex_offset], *mesh_normal = &mesh_normal_[t.vertex_offset];
+		m.assign(mesh_vertex, mesh_vertex + t.vertex_count);
+		for(int k = 0; k < t.vertex_count; k++)
+			mesh_vertex[remap[k]] = m[k];
+		m.assign(mesh_normal, mesh_normal + t.vertex_count);
+		for(int k = 0; k < t.vertex_count; k++)
+			mesh_normal[remap[k]] = m[k];
+		for(int j = 0; j < t.count; j++)
+			index[j] += t.vertex_offset;
+	});
+	triangel_valid_ = false;
+}
+
+double Mesher::ACMR(unsigned int cache_size) {
+	return VertexCache::ACMR(mesh_index_.data(), mesh_index_.size(), cache_size);
+}
+
 void Mesher::PrintFace(int f_i) {
-	if(!face_[f_i]) return;
-	Face *f_p = face_[f_i];
-	Loop *l = f_p->loop;
+	if(face_[f_i].loop == -1) return;
+	Face &f = face_[f_i];
+	int l = f.loop;
 	int l_i = 0;
 	do {
-		HalfEdge *he = l->half_edge;
+		int he = loop_[l].half_edge;
 		int he_i = 0;
 		do {
-			int v_i = he->vertex;
-			glm::dvec3 &v = vertex_[v_i]->position;
+			int v_i = he_vertex_[he];
+			glm::dvec3 &v = vertex_[v_i].position;
 			printf("f%-2d l%-2d he%-2d v%-2d: %g %g %g\n", f_i, l_i, he_i, v_i, v.x, v.y, v.z);
-			he = he->next;
+			he = he_next_[he];
 			he_i++;
-		} while(he != l->half_edge);
-		l = l->next;
+		} while(he != loop_[l].half_edge);
+		l = loop_[l].next;
 		l_i++;
-	} while(l != f_p->loop);
+	} while(l != f.loop);
 }
 
 void Mesher::Print() {
@@ -411,27 +1694,136 @@ void Mesher::Print() {
 		PrintFace(f_i);
 }
 
-void Mesher::PrintLoop(Loop *l) {
-	HalfEdge *he = l->half_edge;
+void Mesher::PrintLoop(int l) {
+	int he = loop_[l].half_edge;
 	int he_i = 0;
 	do {
-		int v_i = he->vertex;
-		glm::dvec3 &v = vertex_[v_i]->position;
+		int v_i = he_vertex_[he];
+		glm::dvec3 &v = vertex_[v_i].position;
 		printf("he%-2d v%-2d: %g %g %g\n", he_i, v_i, v.x, v.y, v.z);
-		he = he->next;
+		he = he_next_[he];
 		he_i++;
-	} while(he != l->half_edge);
-	l = l->next;
+	} while(he != loop_[l].half_edge);
 }
 
 void Mesher::MarkBorder() {
+	for(auto &v: vertex_)
+		v.border = false;
 	for(const auto &e: edge_)
-		if(e && !vertex_[e->half_edge[0]->vertex]->border)
-			for(const auto &he: e->half_edge)
-				if(/*face_[he->loop->face] && */!face_[he->loop->face]->visualizable) {
-					vertex_[he->vertex]->border = true;
-					vertex_[he->twin->vertex]->border = true;
+		if(e.half_edge[0] != -1)
+			for(const auto &he: e.half_edge)
+				if(!face_[loop_[he_loop_[he]].face].visualizable) {
+					vertex_[he_vertex_[he]].border = true;
+					vertex_[he_vertex_[he_twin_[he]]].border = true;
 				}
 }
 
+bool Mesher::OnBorder(int v) {
+	int he = vertex_[v].half_edge;
+	if(he == -1) return false;
+	do {
+		if(!face_[loop_[he_loop_[he]].face].visualizable
+			|| !face_[loop_[he_loop_[he_twin_[he]]].face].visualizable)
+			return true;
+		he = he_next_[he_twin_[he]];
+	} while(he != vertex_[v].half_edge);
+	return false;
+}
+
+// Only the vertices of the touched and new faces can have changed: an operator changes the
+// edges or the visibility of the faces it touches, and a vertex keeps all its faces else.
+void Mesher::UpdateBorder() {
+	for(int f = face_border_.size(); f < (int)face_.size(); f++)
+		border_face_.push_back(f);
+	face_border_.resize(face_.size(), false);
+
+	for(int f: border_face_) {
+		if(f >= (int)face_.size()) continue; // undone
+		face_border_[f] = false;
+		int l = face_[f].loop;
+		if(l == -1) continue;
+		do {
+			int he = loop_[l].half_edge;
+			if(he != -1)
+				do {
+					vertex_[he_vertex_[he]].border = OnBorder(he_vertex_[he]);
+					he = he_next_[he];
+				} while(he != loop_[l].half_edge);
+			l = loop_[l].next;
+		} while(l != face_[f].loop);
+	}
+	border_face_.clear();
+}
+
+
+bool Mesher::Validate(bool deep) {
+	auto Fail = [](const std::string &message) {
+		std::cerr << "invalid solid: " << message << std::endl;
+		return false;
+	};
+	auto Name = [](const char *kind, int i) {
+		return kind + std::to_string(i);
+	};
+	const Topology &t = topology_;
+	if(t.vertex - t.edge + t.face - (t.loop - t.face) != 2 * (t.solid - t.hole))
+		return Fail("V - E + F - (L - F) != 2 (S - H)");
+	if(t.vertex != (int)vertex_.size() || t.solid != (int)solid_.size())
+		return Fail("vertex or solid count out of date");
+	if(!deep) return true;
+
+	int he_count = he_edge_.size();
+	auto Live = [&](int he) {
+		return he >= 0 && he < he_count && he_edge_[he] != -1 && he_loop_[he] >= 0 && he_loop_[he] < (int)loop_.size()
+			&& loop_[he_loop_[he]].face >= 0 && loop_[he_loop_[he]].face < (int)face_.size();
+	};
+	Topology count;
+	std::vector<char> visited(he_count, false);
+	for(int f = 0; f < (int)face_.size(); f++) {
+		int first_loop = face_[f].loop;
+		if(first_loop == -1) continue;
+		count.face++;
+		int l = first_loop;
+		do {
+			if(loop_[l].face != f) return Fail(Name("l", l) + " is on " + Name("f", f) + " but says otherwise");
+			if(loop_[loop_[l].next].prev != l) return Fail(Name("l", l) + ": next's prev is another loop");
+			if(++count.loop > (int)loop_.size()) return Fail("the loops of " + Name("f", f) + " do not close");
+			int first = loop_[l].half_edge;
+			if(first != -1) {
+				int he = first;
+				do {
+					if(!Live(he)) return Fail(Name("l", l) + " runs into a dead half-edge");
+					if(visited[he]) return Fail(Name("he", he) + " is met twice walking the loops");
+					visited[he] = true;
+					int next = he_next_[he], twin = he_twin_[he];
+					if(he_loop_[he] != l) return Fail(Name("he", he) + " is on " + Name("l", l) + " but says otherwise");
+					if(!Live(next) || he_prev_[next] != he) return Fail(Name("he", he) + ": next's prev is another half-edge");
+					if(!Live(twin) || he_twin_[twin] != he || he_edge_[twin] != he_edge_[he])
+						return Fail(Name("he", he) + ": twin's twin is another half-edge");
+					if(he_vertex_[next] != he_vertex_[twin]) return Fail(Name("he", he) + " does not end where next starts");
+					if(face_[loop_[he_loop_[twin]].face].solid != face_[f].solid)
+						return Fail(Name("he", he) + ": twin is on another solid");
+					he = next;
+				} while(he != first);
+			}
+			l = loop_[l].next;
+		} while(l != first_loop);
+	}
+	for(int e = 0; e < (int)edge_.size(); e++) {
+		if(edge_[e].half_edge[0] == -1) continue;
+		count.edge++;
+		int he0 = edge_[e].half_edge[0], he1 = edge_[e].half_edge[1];
+		if(!Live(he0) || !Live(he1) || !visited[he0] || !visited[he1])
+			return Fail(Name("e", e) + " is on no live loop");
+		if(he_edge_[he0] != e || he_twin_[he0] != he1) return Fail(Name("e", e) + ": half-edges disagree");
+	}
+	for(int v = 0; v < (int)vertex_.size(); v++) {
+		int he = vertex_[v].half_edge;
+		if(he != -1 && (he < 0 || he >= he_count || !visited[he] || he_vertex_[he] != v))
+			return Fail(Name("v", v) + ": half-edge does not leave it");
+	}
+	if(count.edge != t.edge || count.face != t.face || count.loop != t.loop)
+		return Fail("counts out of date");
+	return true;
+}
+
 }
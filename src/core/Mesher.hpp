@@ -1,10 +1,17 @@
 #pragma once
 
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <unordered_set>
+#include <utility>
 #include <vector>
 #include <sstream>
 
 #include <glm/glm.hpp>
 
+#include "Snapshot.hpp"
+
 #define VERSION_MAJOR 0
 #define VERSION_MINOR 1
 #define VERSION_PATCH 1
@@ -15,195 +22,343 @@
 
 namespace mesher {
 
-struct Face;
-struct Loop;
-struct Edge;
-struct HalfEdge;
-struct Vertex;
-
+// Entities live in contiguous arrays and refer to each other by index (-1 for none).
+// Killed faces and edges stay in their arrays as tombstones so that the indices used
+// by the operator log remain valid.
 struct Solid {
 	int face;
-	// Edge *edge;
-	// Vertex *vertex;
+
+	Solid(int face) : face(face) {}
 };
 struct Face {
 	int solid;
 
-	Loop *loop;
+	int loop; // -1 once the face is killed
 
-	// glm::vec3 normal;
+	// plane dot(normal, p) + offset = 0 of the outer loop by Newell's method, brought up to
+	// date by Triangulate() for the faces operators touched
+	glm::dvec3 normal = glm::dvec3(0);
+	double offset = 0;
+	int outer = 0; // position of the outer loop in the ring of loops
 	bool visualizable = true;
+
+	Face(int solid, int loop) : solid(solid), loop(loop) {}
 };
 struct Loop {
 	int face;
 
-	Loop *prev, *next;
-	HalfEdge *half_edge;
+	int prev, next;
+	int half_edge;
 
-	Loop(int face) : face(face) {
-		prev = next = this;
+	Loop(int face, int self) : face(face), half_edge(-1) {
+		prev = next = self;
 	}
 };
 struct Edge {
 	// Solid *solid;
-	HalfEdge *half_edge[2];
-};
-struct HalfEdge {
-	int edge;
-	int vertex;
+	int half_edge[2]; // -1 once the edge is killed
 
-	HalfEdge *prev, *next;
-	Loop *loop;
-
-	HalfEdge *twin;
-
-	HalfEdge(int edge, int vertex) : edge(edge), vertex(vertex) {}
+	Edge(int he0, int he1) {
+		half_edge[0] = he0;
+		half_edge[1] = he1;
+	}
 };
 struct Vertex {
 	glm::dvec3 position;
 	// glm::vec3 normal;
 
+	int half_edge = -1; // any outgoing half-edge, -1 while isolated
+
 	bool border = false;
 
 	Vertex(glm::dvec3 position) : position(position) {}
 };
 
+// Old-to-new index tables returned by Mesher::Compact(), -1 for killed entities.
+struct Remap {
+	std::vector<int> solid;
+	std::vector<int> face;
+	std::vector<int> edge;
+	std::vector<int> vertex;
+};
+
+// Live entities of all solids, kept up to date by the Euler operators. Rings are the loops
+// of a face beyond its first, holes the handles made by KfMrh; together they satisfy the
+// Euler-Poincare formula V - E + F - (L - F) = 2 (S - H).
+struct Topology {
+	int vertex = 0, edge = 0, face = 0, loop = 0, solid = 0, hole = 0;
+};
+
+enum OperatorEnum : uint8_t { // tags of the .opb records, do not reorder
+	Euler_Mvfs,
+	Euler_Mve,
+	Euler_Mef,
+	Euler_KeMr,
+	Euler_KfMrh,
+	Op_Sweep,
+};
+// One entry of the operator log, stored as is in .opb files. Unused fields are zero.
+// Mvfs: p. Mve: p, v0 f. Mef: v0 v1 f0. KeMr: e f. KfMrh: f0 f1. Sweep: f, d, t.
+struct Operator {
+	uint8_t op;
+	uint8_t pad[3];
+	int32_t n[3];
+	float x[4];
+	Operator() {}
+	Operator(OperatorEnum op, int n0, int n1, int n2, glm::vec3 p = glm::vec3(0), float t = 0)
+		: op(op), pad(), n{n0, n1, n2}, x{p.x, p.y, p.z, t} {}
+	glm::vec3 p() const {
+		return glm::vec3(x[0], x[1], x[2]);
+	}
+};
+
+class TextWriter;
+class Triangulator;
+
 class Mesher {
-	enum OperatorEnum : unsigned char { // useless now
-		Euler_Mvfs,
-		Euler_Mve,
-		Euler_Mef,
-		Euler_KeMr,
-		Euler_KfMrh,
-		Op_Sweep,
-	};
-	struct OperatorBase {
-		OperatorEnum op;
-		OperatorBase(OperatorEnum op) : op(op) {}
-		virtual void Execute(Mesher &mesh) = 0;
-		virtual std::string ToString() = 0;
+	std::vector<Operator> operator_;
+	unsigned int built_ = 0; // operators of the log already run by Build()
+
+	std::vector<Solid> solid_;
+	std::vector<Face> face_;
+	std::vector<Loop> loop_;
+	std::vector<Edge> edge_;
+	std::vector<Vertex> vertex_;
+
+	// half-edges as a structure of arrays, so that walking a loop only touches the links
+	std::vector<int> he_next_;
+	std::vector<int> he_prev_;
+	std::vector<int> he_twin_;
+	std::vector<int> he_loop_;
+	std::vector<int> he_vertex_;
+	std::vector<int> he_edge_;
+
+	// killed loops and half-edges have no id in the operator log, so their slots are reused
+	std::vector<int> free_loop_;
+	std::vector<int> free_half_edge_;
+
+	Topology topology_;
+
+	// state of the kernel after the first built operators, taken by Build() every
+	// snapshot_interval_ operators
+	struct Snapshot {
+		unsigned int built;
+		ChunkedArray<Solid> solid;
+		ChunkedArray<Face> face;
+		ChunkedArray<Loop> loop;
+		ChunkedArray<Edge> edge;
+		ChunkedArray<Vertex> vertex;
+		ChunkedArray<int> he_next, he_prev, he_twin, he_loop, he_vertex, he_edge;
+		ChunkedArray<int> free_loop, free_half_edge;
+		Topology topology;
 	};
-	struct EulerMvfs : public OperatorBase {
-		glm::vec3 p;
-		EulerMvfs(float x, float y, float z)
-			: OperatorBase(Euler_Mvfs), p(x, y, z) {}
-		void Execute(Mesher &mesh) override {
-			mesh.Mvfs(p);
-		}
-		std::string ToString() override {
-			std::stringstream ss;
-			ss << "Mvfs (" << p.x << " " << p.y << " " << p.z << ")";
-			return ss.str();
-		};
+	std::vector<Snapshot> snapshot_;
+	unsigned int snapshot_interval_ = 0;
+
+	// What a primitive needs to be reverted exactly, by its inverse Euler operator. The ids
+	// it created are the last ones of their arrays and are not kept, sizes tell whether a
+	// slot came from a free list.
+	enum UndoEnum : uint8_t {
+		Undo_Kvfs, // of Mvfs: loop_size
+		Undo_Kev, // of MveAt: he_size
+		Undo_Kef, // of MefAt: he_size, loop_size, l0's half-edge
+		Undo_MeKr, // of KeMr: e, f, v0, v1, their half-edges, l0's half-edge, loop_size
+		Undo_MfKrh, // of KfMrh: f0, f1, f1's loop
+		Undo_Visible, // f, visualizable
 	};
-	struct EulerMve : public OperatorBase {
-		glm::vec3 p;
-		int v0, f;
-		EulerMve(float x, float y, float z, int v0, int f)
-			: OperatorBase(Euler_Mve), p(x, y, z), v0(v0), f(f) {}
-		void Execute(Mesher &mesh) override {
-			mesh.Mve(p, v0, f);
-		}
-		std::string ToString() override {
-			std::stringstream ss;
-			ss << "Mve (" << p.x << " " << p.y << " " << p.z << ") v" << v0 << " f" << f;
-			return ss.str();
-		};
+	struct UndoRecord {
+		UndoEnum op;
+		int n[8];
 	};
-	struct EulerMef : public OperatorBase {
-		int v0, v1, f0;
-		EulerMef(int v0, int v1, int f0)
-			: OperatorBase(Euler_Mef), v0(v0), v1(v1), f0(f0) {}
-		void Execute(Mesher &mesh) override {
-			mesh.Mef(v0, v1, f0);
-		}
-		std::string ToString() override {
-			std::stringstream ss;
-			ss << "Mef v" << v0 << " v" << v1 << " f" << f0;
-			return ss.str();
-		};
+	bool keep_undo_ = false;
+	std::vector<UndoRecord> undo_;
+	std::vector<std::pair<unsigned int, unsigned int>> undo_mark_; // operator, its first record
+	std::vector<Operator> redo_;
+
+	// triangle output, three corners per triangle, expanded from the indexed output only when
+	// asked for
+	std::vector<glm::vec3> triangel_vertex_;
+	std::vector<glm::vec3> triangel_normal_;
+	bool triangel_valid_ = false;
+
+	// indexed output, every face has its own vertices since the normals are flat
+	std::vector<glm::vec3> mesh_vertex_;
+	std::vector<glm::vec3> mesh_normal_;
+	std::vector<uint32_t> mesh_index_;
+
+	// where each face sits in the outputs; faces touched by an operator since the last
+	// Triangulate() are dirty, faces beyond the end of the array are new
+	struct FaceTriangles {
+		int offset = -1, count = 0; // in the triangle output and the index buffer
+		int vertex_offset = -1, vertex_count = 0; // in the indexed vertices
+		bool dirty = true;
 	};
-	struct EulerKeMr : public OperatorBase {
-		int e, f;
-		EulerKeMr(int e, int f)
-			: OperatorBase(Euler_KeMr), e(e), f(f) {}
-		void Execute(Mesher &mesh) override {
-			mesh.KeMr(e, f);
-		}
-		std::string ToString() override {
-			std::stringstream ss;
-			ss << "KeMr e" << e << " f" << f;
-			return ss.str();
-		};
+	std::vector<FaceTriangles> face_triangles_;
+
+	// faces whose vertices may have to change their border flag at the next Build(), each
+	// once; faces beyond the end of face_border_ are new
+	std::vector<char> face_border_;
+	std::vector<int> border_face_;
+
+	// numbers of entities of each kind, or where the entities of a kernel land in another
+	struct Count {
+		int solid = 0, face = 0, loop = 0, edge = 0, half_edge = 0, vertex = 0;
 	};
-	struct EulerKfMrh : public OperatorBase {
-		int f0, f1;
-		EulerKfMrh(int f0, int f1)
-			: OperatorBase(Euler_KfMrh), f0(f0), f1(f1) {}
-		void Execute(Mesher &mesh) override {
-			mesh.KfMrh(f0, f1);
-		}
-		std::string ToString() override {
-			std::stringstream ss;
-			ss << "KfMrh f" << f0 << " f" << f1;
-			return ss.str();
-		};
+	// the kernel as the operators checked so far leave it, started from the current one
+	struct Check {
+		bool exact = true; // after a Sweep the counts are lower bounds
+		int face = 0, edge = 0, vertex = 0;
+		int free_loop = 0, free_half_edge = 0;
+		std::unordered_set<int> face_killed, edge_killed;
 	};
-	struct OpSweep : public OperatorBase {
-		int f;
-		glm::vec3 d;
-		float t;
-		OpSweep(int f, float x, float y, float z, float t)
-			: OperatorBase(Op_Sweep), f(f), d(x, y, z), t(t) {}
-		void Execute(Mesher &mesher) override {
-			mesher.Sweep(f, d, t);
-		}
-		std::string ToString() override {
-			std::stringstream ss;
-			ss << "Sweep f" << f << " (" << d.x << " " << d.y << " " << d.z << ") " << t;
-			return ss.str();
-		};
+	// operators from begin to end that only refer to entities they create, so that they can
+	// be built in a kernel of their own; their ids in the log are the offsets plus the ids
+	// in that kernel
+	struct Part {
+		unsigned int begin, end;
+		int solid, face, edge, vertex;
 	};
 
-	std::vector<OperatorBase*> operator_;
-
-	std::vector<Solid*> solid_;
-	std::vector<Face*> face_;
-	std::vector<Edge*> edge_;
-	std::vector<Vertex*> vertex_;
-
-	std::vector<glm::vec3> triangel_vertex_;
-	std::vector<glm::vec3> triangel_normal_;
-
-	bool InLoop(int v, Loop *l);
-	void AddLoop(int f, Loop *l1);
-	void SetLoop(HalfEdge *he, Loop *l);
+	void Touch(int f);
+	int NewLoop(int face);
+	int NewHalfEdge(int edge, int vertex);
+	void DeleteHalfEdge(int he);
+	void ReleaseHalfEdge(int he, int he_size);
+	void ReleaseLoop(int l, int loop_size);
+	void PopFace();
+	void PushUndo(UndoEnum op, int n0 = 0, int n1 = 0, int n2 = 0, int n3 = 0, int n4 = 0, int n5 = 0, int n6 = 0, int n7 = 0);
+	void SetVisible(int f, bool visible);
+	bool InLoop(int v, int l);
+	int FindLoop(int v, int f);
+	int FindIncoming(int v, int l, int start);
+	void AddLoop(int f, int l1);
+	void SetLoop(int he, int l);
+	void Reserve(int solid, int face, int loop, int edge, int half_edge, int vertex);
 	void Mvfs(glm::vec3 p);
-	int Mve(glm::vec3 p, int v0, Loop *l);
+	int MveAt(glm::vec3 p, int v0, int l, int he);
 	int Mve(glm::vec3 p, int v0, int f);
-	void Mef(int v0, int v1, Loop *l0);
+	void MefAt(int l0, int he_v0, int he_v1);
 	void Mef(int v0, int v1, int f0);
 	void KeMr(int e, int f);
 	void KfMrh(int f0, int f1);
 	void Sweep(int f, glm::dvec3 d, double t);
+	void Kvfs(const UndoRecord &u);
+	void Kev(const UndoRecord &u);
+	void Kef(const UndoRecord &u);
+	void MeKr(const UndoRecord &u);
+	void MfKrh(const UndoRecord &u);
+	void Revert(const UndoRecord &u);
+	int TriangleCount(int f, int &vertex_count);
+	void UpdatePlane(int f);
+	const std::vector<int> &TriangulateFace(int f, Triangulator &triangulator);
+	void Execute(const Operator &o);
+	void ExpandTriangles();
+	void StartCheck(Check &check);
+	bool CheckOperator(Check &check, const Operator &o, Count &growth, std::string &error);
+	bool CheckKernel(const Operator &o, std::string &error);
+	bool DryRun(Count &growth, bool report = true);
+	bool Run(unsigned int end, bool swept, bool report = true);
+	void SplitParts(std::vector<Part> &part);
+	bool BuildParts(const std::vector<Part> &part, unsigned int thread_count);
+	void Place(const Mesher &m, const Count &at);
+	bool OnBorder(int v);
+	void UpdateBorder();
+	void ClearKernel();
+	void TakeSnapshot();
+	void RestoreSnapshot(const Snapshot &snapshot);
+	void WriteOperator(TextWriter &w, const Operator &o);
+	std::string ToString(const Operator &o);
+	// Hands the operators of the file to flush in batches, text or binary alike. Reading stops,
+	// and false is returned, as soon as flush returns false.
+	bool ReadOperator(const char *file, const std::function<bool(const Operator *o, size_t n)> &flush);
+	bool ReadOperatorBinary(const char *file, const std::function<bool(const Operator *o, size_t n)> &flush);
+	bool SaveOperatorBinary(const char *file);
 
 public:
-	void LoadOperator(const char *file);
-	void SaveOperator(const char *file);
+	// Files ending in .opb are read and written as binary records, others as text, which
+	// reads back exactly.
+	bool LoadOperator(const char *file);
+	bool SaveOperator(const char *file);
 	void PrintOperator();
-	void Build();
-	std::vector<glm::vec3> &Triangulate();
+	void AddOperator(const Operator &o);
+	const std::vector<Operator> &operators() {
+		return operator_;
+	}
+	// Runs the operators added since the last call and updates the border flags of the
+	// vertices around the faces they touched. Returns false without running any when one
+	// of them refers to an entity that does not exist or is killed by then; past a Sweep
+	// this is only known as they run, and the ones before the bad one stay built. The solids
+	// started by the Mvfs of the new operators are built on thread_count threads (0 for all
+	// hardware threads) when they refer to nothing outside, unless snapshots or undo are
+	// kept; the result does not depend on it.
+	bool Build(unsigned int thread_count = 1);
+	// Build() keeps the state after every interval operators from then on, 0 to stop.
+	void SnapshotInterval(unsigned int interval) {
+		snapshot_interval_ = interval;
+	}
+	// Brings the solid to its state after the first k operators of the log, from the
+	// nearest snapshot before k or the current state, whichever is closer.
+	void Seek(unsigned int k);
+	// Build() keeps what it needs to undo each operator from then on.
+	void KeepUndo(bool keep) {
+		keep_undo_ = keep;
+	}
+	// Reverts the last operator of the log through the inverse Euler operators, in the
+	// time it took to run it, and sets it aside for Redo(). Only operators built while
+	// undo was kept can be undone, and only when the whole log is built.
+	bool Undo();
+	bool Redo();
+	// Runs the operators of the file as they are read, without keeping them in the log.
+	// Returns false on unreadable or malformed input or on an operator referring to what does
+	// not exist or is killed, the operators before it are run. Nothing built before can be
+	// undone or redone afterwards.
+	bool BuildStream(const char *file);
+	void Clear();
+	// Packs the live entities densely. Ids held by the caller (and by the operator log)
+	// must be translated through the returned tables afterwards. Drops the snapshots.
+	Remap Compact();
+	// Fills the indexed output. Only the faces touched since the last call are triangulated
+	// again. They are spread over thread_count threads (0 for all hardware threads), the
+	// output does not depend on it.
+	void Triangulate(unsigned int thread_count = 1);
 	std::vector<glm::vec3> TriangulateFace(int f);
+	// Reorders the triangles of each face of the last Triangulate() for a post-transform
+	// vertex cache of cache_size vertices, then its vertices in the order they are first used.
+	// Faces share no vertices, so each keeps its place in the outputs; faces triangulated again
+	// later come out in the triangulator's order until the next call.
+	void OptimizeVertexCache(unsigned int cache_size = 16, unsigned int thread_count = 1);
+	// Average cache miss ratio of the index buffer: vertices a FIFO cache of cache_size
+	// loads per triangle.
+	double ACMR(unsigned int cache_size = 16);
+	// Writes the indexed output of the last Triangulate(): vertex and index counts as two
+	// uint32_t, then the vertices, the normals (3 floats each) and the uint32_t indices.
+	bool SaveMesh(const char *file);
 	void PrintFace(int f);
 	void Print();
-	void PrintLoop(Loop *l);
-	std::vector<glm::vec3> &triangel_vertex() {
-		return triangel_vertex_;
+	void PrintLoop(int l);
+	// The indexed output of the last Triangulate() with three corners per triangle, expanded
+	// at the first call after it.
+	std::vector<glm::vec3> &triangel_vertex();
+	std::vector<glm::vec3> &triangel_normal();
+	std::vector<glm::vec3> &mesh_vertex() {
+		return mesh_vertex_;
 	}
-	std::vector<glm::vec3> &triangel_normal() {
-		return triangel_normal_;
+	std::vector<glm::vec3> &mesh_normal() {
+		return mesh_normal_;
 	}
+	std::vector<uint32_t> &mesh_index() {
+		return mesh_index_;
+	}
+	// A vertex is on the border when one of its edges has an invisible face on a side.
 	void MarkBorder();
+	const Topology &topology() {
+		return topology_;
+	}
+	// Checks the Euler-Poincare formula on the counts kept by the operators, in O(1). The deep
+	// check also walks every face, loop and half-edge, checks that twins, next and prev links
+	// agree and stay in one solid, and counts the live entities again. Reports the first
+	// problem on std::cerr.
+	bool Validate(bool deep = false);
 };
 
 }
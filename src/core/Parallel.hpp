@@ -0,0 +1,37 @@
+#pragma once
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace mesher {
+
+// 0 stands for one thread per hardware thread.
+inline unsigned int ThreadCount(unsigned int thread_count) {
+	if(thread_count == 0) thread_count = std::thread::hardware_concurrency();
+	return thread_count == 0 ? 1 : thread_count;
+}
+
+// Calls f(thread, i) for every i in [0, n) on ThreadCount(thread_count) threads, the
+// calling one included. Items are handed out one at a time, so uneven items balance out.
+template <typename F>
+void ParallelFor(int n, unsigned int thread_count, F f) {
+	thread_count = ThreadCount(thread_count);
+	if(thread_count == 1 || n <= 1) {
+		for(int i = 0; i < n; i++) f(0, i);
+		return;
+	}
+
+	std::atomic<int> next(0);
+	auto work = [&](unsigned int thread) {
+		for(int i = next++; i < n; i = next++) f(thread, i);
+	};
+	std::vector<std::thread> worker;
+	for(unsigned int t = 1; t < thread_count; t++)
+		worker.push_back(std::thread(work, t));
+	work(0);
+	for(auto &w: worker)
+		w.join();
+}
+
+}
@@ -0,0 +1,71 @@
+#include "Simd.hpp"
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define MESHER_X64
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+namespace mesher {
+
+void ToFloatScalar(const double *in, float *out, size_t n) {
+	for(size_t i = 0; i < n; i++)
+		out[i] = (float)in[i];
+}
+
+#ifdef MESHER_X64
+void ToFloatSSE2(const double *in, float *out, size_t n) {
+	size_t i = 0;
+	for(; i + 4 <= n; i += 4) {
+		__m128 a = _mm_cvtpd_ps(_mm_loadu_pd(in + i));
+		__m128 b = _mm_cvtpd_ps(_mm_loadu_pd(in + i + 2));
+		_mm_storeu_ps(out + i, _mm_movelh_ps(a, b));
+	}
+	ToFloatScalar(in + i, out + i, n - i);
+}
+
+#ifdef __GNUC__
+__attribute__((target("avx")))
+#endif
+void ToFloatAVX(const double *in, float *out, size_t n) {
+	size_t i = 0;
+	for(; i + 8 <= n; i += 8) {
+		__m128 a = _mm256_cvtpd_ps(_mm256_loadu_pd(in + i));
+		__m128 b = _mm256_cvtpd_ps(_mm256_loadu_pd(in + i + 4));
+		_mm256_storeu_ps(out + i, _mm256_insertf128_ps(_mm256_castps128_ps256(a), b, 1));
+	}
+	for(; i < n; i++)
+		out[i] = (float)in[i];
+}
+
+// AVX also needs the system to save the upper halves of the registers.
+bool HasAVX() {
+#ifdef _MSC_VER
+	int info[4];
+	__cpuid(info, 1);
+	bool osxsave = (info[2] & (1 << 27)) != 0, avx = (info[2] & (1 << 28)) != 0;
+	return osxsave && avx && (_xgetbv(0) & 6) == 6;
+#else
+	return __builtin_cpu_supports("avx");
+#endif
+}
+#endif
+
+typedef void (*ToFloatFunction)(const double *in, float *out, size_t n);
+
+ToFloatFunction SelectToFloat() {
+#ifdef MESHER_X64
+	return HasAVX() ? ToFloatAVX : ToFloatSSE2;
+#else
+	return ToFloatScalar;
+#endif
+}
+
+void ToFloat(const double *in, float *out, size_t n) {
+	static const ToFloatFunction to_float = SelectToFloat();
+	to_float(in, out, n);
+}
+
+}
@@ -0,0 +1,11 @@
+#pragma once
+
+#include <cstddef>
+
+namespace mesher {
+
+// Converts n doubles to floats, rounding like a cast. Uses AVX when the processor has it,
+// SSE2 on other x86-64 processors and plain C++ elsewhere; the result is the same.
+void ToFloat(const double *in, float *out, size_t n);
+
+}
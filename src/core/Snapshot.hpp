@@ -0,0 +1,44 @@
+#pragma once
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+namespace mesher {
+
+// Copy of an array cut into fixed-size chunks. A chunk equal to the one at the same place
+// in the previous copy is shared with it instead of stored again, so a series of copies of
+// an array that mostly grows at the end costs little more than the last one.
+template <typename T>
+class ChunkedArray {
+	static const size_t CHUNK = 1024;
+	std::vector<std::shared_ptr<const std::vector<T>>> chunk_;
+	size_t size_ = 0;
+
+public:
+	void Store(const std::vector<T> &v, const ChunkedArray *previous) {
+		size_ = v.size();
+		chunk_.resize((size_ + CHUNK - 1) / CHUNK);
+		for(size_t c = 0; c < chunk_.size(); c++) {
+			const T *begin = v.data() + c * CHUNK;
+			size_t n = std::min(CHUNK, size_ - c * CHUNK);
+			if(previous && c < previous->chunk_.size()) {
+				const std::vector<T> &p = *previous->chunk_[c];
+				if(p.size() == n && !memcmp((const void*)p.data(), (const void*)begin, sizeof(T) * n)) {
+					chunk_[c] = previous->chunk_[c];
+					continue;
+				}
+			}
+			chunk_[c] = std::make_shared<const std::vector<T>>(begin, begin + n);
+		}
+	}
+	void Load(std::vector<T> &v) const {
+		v.clear();
+		v.reserve(size_);
+		for(const auto &c: chunk_)
+			v.insert(v.end(), c->begin(), c->end());
+	}
+};
+
+}
@@ -0,0 +1,167 @@
+#include "TextParser.hpp"
+
+#include <climits>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+namespace mesher {
+
+bool IsDigit(char c) {
+	return c >= '0' && c <= '9';
+}
+
+bool IsLetter(char c) {
+	return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+
+void TextParser::Skip() {
+	while(p_ < end_) {
+		if(*p_ == '#') {
+			const char *eol = (const char*)memchr(p_, '\n', end_ - p_);
+			p_ = eol ? eol : end_;
+		} else if(*p_ == ' ' || *p_ == '\t' || *p_ == '\n' || *p_ == '\r') {
+			p_++;
+		} else {
+			break;
+		}
+	}
+}
+
+bool TextParser::End() {
+	Skip();
+	return p_ == end_;
+}
+
+bool TextParser::Word(const char *&word, int &length) {
+	Skip();
+	const char *p = p_;
+	while(p < end_ && IsLetter(*p))
+		p++;
+	if(p == p_) return Fail("expected a word");
+	word = p_;
+	length = p - p_;
+	p_ = p;
+	return true;
+}
+
+bool TextParser::Expect(char c) {
+	Skip();
+	if(p_ == end_ || *p_ != c) {
+		char message[] = "expected 'x'";
+		message[10] = c;
+		return Fail(message);
+	}
+	p_++;
+	return true;
+}
+
+bool TextParser::Integer(int &n) {
+	const char *p = p_;
+	bool negative = false;
+	if(p < end_ && (*p == '-' || *p == '+')) negative = *p++ == '-';
+	if(p == end_ || !IsDigit(*p)) return Fail("expected an integer");
+	long long value = 0;
+	for(; p < end_ && IsDigit(*p); p++) {
+		value = value * 10 + (*p - '0');
+		if(value > (long long)INT_MAX + 1) return Fail("integer out of range");
+	}
+	if(negative) value = -value;
+	if(value > INT_MAX) return Fail("integer out of range");
+	n = (int)value;
+	p_ = p;
+	return true;
+}
+
+bool TextParser::Int(int &n) {
+	Skip();
+	return Integer(n);
+}
+
+bool TextParser::Index(char prefix, int &n) {
+	Skip();
+	if(p_ < end_ && IsLetter(*p_)) {
+		if(*p_ != prefix) {
+			char message[] = "expected an index like x0";
+			message[23] = prefix;
+			return Fail(message);
+		}
+		p_++;
+	}
+	return Integer(n);
+}
+
+// A mantissa up to FAST_MANTISSA_MAX and a power of ten up to FAST_EXPONENT_MAX are both
+// exact in a float, so a single multiplication or division rounds correctly like strtof.
+// Other numbers go to strtof.
+bool TextParser::Float(float &x) {
+	Skip();
+	const char *p = p_;
+	bool negative = false;
+	if(p < end_ && (*p == '-' || *p == '+')) negative = *p++ == '-';
+
+	uint64_t mantissa = 0;
+	int digits = 0, exponent = 0;
+	bool any = false;
+	for(; p < end_ && IsDigit(*p); p++) {
+		any = true;
+		if(digits < 19) {
+			mantissa = mantissa * 10 + (*p - '0');
+			if(mantissa) digits++;
+		} else {
+			exponent++;
+		}
+	}
+	if(p < end_ && *p == '.') {
+		for(p++; p < end_ && IsDigit(*p); p++) {
+			any = true;
+			if(digits < 19) {
+				mantissa = mantissa * 10 + (*p - '0');
+				if(mantissa) digits++;
+				exponent--;
+			}
+		}
+	}
+	if(!any) return Fail("expected a number");
+	if(p < end_ && (*p == 'e' || *p == 'E')) {
+		const char *q = p + 1;
+		bool exponent_negative = false;
+		if(q < end_ && (*q == '-' || *q == '+')) exponent_negative = *q++ == '-';
+		if(q == end_ || !IsDigit(*q)) return Fail("expected an exponent", q);
+		int e = 0;
+		for(; q < end_ && IsDigit(*q); q++)
+			if(e < 10000) e = e * 10 + (*q - '0');
+		exponent += exponent_negative ? -e : e;
+		p = q;
+	}
+
+	if(mantissa <= FAST_MANTISSA_MAX && exponent >= -FAST_EXPONENT_MAX && exponent <= FAST_EXPONENT_MAX) {
+		x = exponent < 0 ? (float)mantissa / POW10[-exponent] : (float)mantissa * POW10[exponent];
+		if(negative) x = -x;
+	} else {
+		char buffer[64];
+		if(p - p_ >= (long)sizeof(buffer)) return Fail("number too long");
+		memcpy(buffer, p_, p - p_);
+		buffer[p - p_] = '\0';
+		x = strtof(buffer, nullptr);
+	}
+	p_ = p;
+	return true;
+}
+
+bool TextParser::Fail(const char *message, const char *at) {
+	if(!at) at = p_;
+	int line = 1, column = 1;
+	for(const char *p = begin_; p < at; p++) {
+		if(*p == '\n') {
+			line++;
+			column = 1;
+		} else {
+			column++;
+		}
+	}
+	error_ = std::to_string(line) + ":" + std::to_string(column) + ": " + message;
+	return false;
+}
+
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace mesher {
+
+// A float with a mantissa up to FAST_MANTISSA_MAX and a decimal exponent up to
+// FAST_EXPONENT_MAX either way is read with one correctly rounded multiplication or
+// division by a power of ten, exact in a float. TextWriter relies on it to write floats
+// that come back exactly.
+const uint32_t FAST_MANTISSA_MAX = 1 << 24;
+const int FAST_EXPONENT_MAX = 10;
+const float POW10[FAST_EXPONENT_MAX + 1] = {1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f};
+
+// Scans tokens in place from a text buffer. Whitespace and comments (from # to the end of
+// the line) are skipped before every token. On malformed input the scan functions return
+// false and error() tells the line and column.
+class TextParser {
+	const char *begin_, *p_, *end_;
+	std::string error_;
+
+	void Skip();
+	bool Integer(int &n);
+
+public:
+	TextParser(const char *data, size_t size) : begin_(data), p_(data), end_(data + size) {}
+	// Whether only whitespace and comments are left.
+	bool End();
+	// A run of letters.
+	bool Word(const char *&word, int &length);
+	bool Expect(char c);
+	bool Int(int &n);
+	bool Float(float &x);
+	// An index written with its kind, like v3 or f0. A bare number is accepted too.
+	bool Index(char prefix, int &n);
+	// Records message at the given position, which defaults to the current one.
+	bool Fail(const char *message, const char *at = nullptr);
+	const std::string &error() {
+		return error_;
+	}
+};
+
+}
@@ -0,0 +1,73 @@
+#include "TextWriter.hpp"
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+
+#include "TextParser.hpp"
+
+namespace mesher {
+
+const size_t BLOCK = 1 << 16;
+
+void TextWriter::Int(int n) {
+	char digit[16];
+	int k = 0;
+	unsigned int u = n < 0 ? 0u - (unsigned int)n : (unsigned int)n;
+	do {
+		digit[k++] = '0' + u % 10;
+		u /= 10;
+	} while(u);
+	if(n < 0) buffer_ += '-';
+	while(k)
+		buffer_ += digit[--k];
+}
+
+// TextParser reads a mantissa up to FAST_MANTISSA_MAX with up to FAST_EXPONENT_MAX
+// decimals back with one correctly rounded division, so the fewest decimals whose nearest
+// mantissa divides back to x are the shortest exact text in that range. Other numbers take
+// the 9 significant digits that always come back through strtof.
+void TextWriter::Float(float x) {
+	if(std::signbit(x)) {
+		buffer_ += '-';
+		x = -x;
+	}
+	for(int k = 0; k <= FAST_EXPONENT_MAX; k++) {
+		double scaled = (double)x * POW10[k];
+		if(scaled > FAST_MANTISSA_MAX) break;
+		uint32_t m = (uint32_t)(scaled + 0.5);
+		if((float)m / POW10[k] != x) continue;
+
+		char digit[16];
+		int n = 0;
+		do {
+			digit[n++] = '0' + m % 10;
+			m /= 10;
+		} while(m);
+		if(n <= k) {
+			buffer_ += "0.";
+			buffer_.append(k - n, '0');
+		}
+		for(int i = n; i > 0; i--) {
+			if(i == k && n > k) buffer_ += '.';
+			buffer_ += digit[i - 1];
+		}
+		return;
+	}
+	char s[32];
+	int n = snprintf(s, sizeof(s), "%.9g", x);
+	buffer_.append(s, n);
+}
+
+void TextWriter::EndLine() {
+	buffer_ += '\n';
+	if(buffer_.size() >= BLOCK) Flush();
+}
+
+void TextWriter::Flush() {
+	if(!os_ || buffer_.empty()) return;
+	os_->write(buffer_.data(), buffer_.size());
+	buffer_.clear();
+}
+
+}
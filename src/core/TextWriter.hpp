@@ -0,0 +1,43 @@
+#pragma once
+
+#include <ostream>
+#include <string>
+
+namespace mesher {
+
+// Formats tokens into a buffer that goes out to the stream in large blocks, the
+// counterpart of TextParser. Floats get the fewest digits TextParser reads back exactly.
+// Without a stream the text just accumulates in buffer().
+class TextWriter {
+	std::ostream *os_;
+	std::string buffer_;
+
+public:
+	explicit TextWriter(std::ostream *os = nullptr) : os_(os) {}
+	~TextWriter() {
+		Flush();
+	}
+	TextWriter(const TextWriter &) = delete;
+	TextWriter &operator=(const TextWriter &) = delete;
+	void Char(char c) {
+		buffer_ += c;
+	}
+	void Word(const char *word) {
+		buffer_ += word;
+	}
+	void Int(int n);
+	void Float(float x);
+	// An index written with its kind, like v3 or f0.
+	void Index(char prefix, int n) {
+		buffer_ += prefix;
+		Int(n);
+	}
+	// Ends the line and writes the buffer out once it is large.
+	void EndLine();
+	void Flush();
+	const std::string &buffer() {
+		return buffer_;
+	}
+};
+
+}
@@ -0,0 +1,298 @@
+#include "Triangulator.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
+
+namespace mesher {
+
+double Cross(const glm::dvec2 &a, const glm::dvec2 &b, const glm::dvec2 &c) {
+	return (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+}
+
+bool PointInTriangle(const glm::dvec2 &a, const glm::dvec2 &b, const glm::dvec2 &c, const glm::dvec2 &p) {
+	double d0 = Cross(a, b, p), d1 = Cross(b, c, p), d2 = Cross(c, a, p);
+	return !((d0 < 0 || d1 < 0 || d2 < 0) && (d0 > 0 || d1 > 0 || d2 > 0));
+}
+
+void Triangulator::Clear() {
+	position_.clear();
+	contour_.assign(1, 0);
+}
+
+void Triangulator::AddVertex(const glm::dvec3 &p) {
+	position_.push_back(p);
+}
+
+void Triangulator::CloseContour() {
+	contour_.push_back(position_.size());
+}
+
+// Whether the diagonal from node a towards node b starts inside the polygon.
+bool Triangulator::LocallyInside(int a, int b) {
+	const glm::dvec2 &p = Point(node_prev_[a]), &q = Point(a), &n = Point(node_next_[a]), &r = Point(b);
+	if(Cross(p, q, n) >= 0)
+		return Cross(q, n, r) >= 0 && Cross(q, p, r) <= 0;
+	return Cross(q, n, r) >= 0 || Cross(q, p, r) <= 0;
+}
+
+int Triangulator::NewNode(int point) {
+	node_point_.push_back(point);
+	node_prev_.push_back(-1);
+	node_next_.push_back(-1);
+	return node_point_.size() - 1;
+}
+
+int Triangulator::LinkContour(int c, bool reverse) {
+	int first = node_point_.size(), n = contour_[c + 1] - contour_[c];
+	for(int i = 0; i < n; i++)
+		NewNode(reverse ? contour_[c + 1] - 1 - i : contour_[c] + i);
+	for(int i = 0; i < n; i++) {
+		node_next_[first + i] = first + (i + 1) % n;
+		node_prev_[first + (i + 1) % n] = first + i;
+	}
+	return first;
+}
+
+// Vertex of the outer polygon visible from the rightmost vertex of a hole (Eberly): cast a
+// ray towards +x, take the nearest upward edge it hits, then the reflex vertex inside the
+// triangle spanned with that edge closest in angle to the ray, if any.
+int Triangulator::FindBridge(int hole, int outer) {
+	const glm::dvec2 m = Point(hole);
+	double qx = std::numeric_limits<double>::infinity();
+	int edge = -1;
+	int node = outer;
+	do {
+		const glm::dvec2 &a = Point(node), &b = Point(node_next_[node]);
+		if(a.y < b.y && a.y <= m.y && m.y <= b.y) {
+			double x = a.x + (m.y - a.y) * (b.x - a.x) / (b.y - a.y);
+			if(x >= m.x && x < qx) {
+				qx = x;
+				edge = node;
+			}
+		}
+		node = node_next_[node];
+	} while(node != outer);
+	if(edge == -1) return outer;
+
+	int bridge = Point(edge).x > Point(node_next_[edge]).x ? edge : node_next_[edge];
+	const glm::dvec2 p = Point(bridge), q(qx, m.y);
+	if(p == q) return bridge;
+
+	double tan_min = std::numeric_limits<double>::infinity();
+	node = edge;
+	do {
+		const glm::dvec2 &r = Point(node);
+		if(m.x < r.x && r.x <= p.x && PointInTriangle(m, q, p, r)) {
+			double tan = std::abs(m.y - r.y) / (r.x - m.x);
+			if(LocallyInside(node, hole) && (tan < tan_min || (tan == tan_min && r.x < Point(bridge).x))) {
+				bridge = node;
+				tan_min = tan;
+			}
+		}
+		node = node_next_[node];
+	} while(node != edge);
+	return bridge;
+}
+
+// Connects node a of the outer polygon with node b of a hole by a pair of opposite edges.
+void Triangulator::Split(int a, int b) {
+	int a2 = NewNode(node_point_[a]), b2 = NewNode(node_point_[b]);
+	int an = node_next_[a], bp = node_prev_[b];
+
+	node_next_[a] = b;
+	node_prev_[b] = a;
+	node_next_[a2] = an;
+	node_prev_[an] = a2;
+	node_next_[b2] = a2;
+	node_prev_[a2] = b2;
+	node_next_[bp] = b2;
+	node_prev_[b2] = bp;
+}
+
+// Interleaved bits of the point scaled to 16 bits per axis.
+unsigned int Triangulator::Z(const glm::dvec2 &p) {
+	unsigned int x = (unsigned int)((p.x - z_min_.x) * z_scale_);
+	unsigned int y = (unsigned int)((p.y - z_min_.y) * z_scale_);
+	x = (x | (x << 8)) & 0x00FF00FF;
+	x = (x | (x << 4)) & 0x0F0F0F0F;
+	x = (x | (x << 2)) & 0x33333333;
+	x = (x | (x << 1)) & 0x55555555;
+	y = (y | (y << 8)) & 0x00FF00FF;
+	y = (y | (y << 4)) & 0x0F0F0F0F;
+	y = (y | (y << 2)) & 0x33333333;
+	y = (y | (y << 1)) & 0x55555555;
+	return x | (y << 1);
+}
+
+void Triangulator::SortZ() {
+	int n = node_point_.size();
+	glm::dvec2 p_min = Point(0), p_max = Point(0);
+	for(int i = 1; i < n; i++) {
+		p_min = glm::min(p_min, Point(i));
+		p_max = glm::max(p_max, Point(i));
+	}
+	double size = std::max(p_max.x - p_min.x, p_max.y - p_min.y);
+	z_min_ = p_min;
+	z_scale_ = size > 0 ? 65535 / size : 0;
+
+	node_z_.resize(n);
+	std::vector<int> order(n);
+	for(int i = 0; i < n; i++) {
+		node_z_[i] = Z(Point(i));
+		order[i] = i;
+	}
+	std::sort(order.begin(), order.end(), [&](int a, int b) {
+		return node_z_[a] < node_z_[b];
+	});
+	node_prev_z_.resize(n);
+	node_next_z_.resize(n);
+	for(int i = 0; i < n; i++) {
+		node_prev_z_[order[i]] = i > 0 ? order[i - 1] : -1;
+		node_next_z_[order[i]] = i + 1 < n ? order[i + 1] : -1;
+	}
+}
+
+// Whether the reflex node r lies in the ear a c b. Nodes on the same point as a corner
+// (the other end of a bridge) never block.
+bool Triangulator::Blocks(int r, int a, int c, int b) {
+	int p = node_point_[r];
+	if(p == node_point_[a] || p == node_point_[c] || p == node_point_[b]) return false;
+	return PointInTriangle(Point(a), Point(c), Point(b), Point(r))
+		&& Cross(Point(node_prev_[r]), Point(r), Point(node_next_[r])) <= 0;
+}
+
+bool Triangulator::IsEar(int c) {
+	int a = node_prev_[c], b = node_next_[c];
+	const glm::dvec2 &pa = Point(a), &pc = Point(c), &pb = Point(b);
+	if(Cross(pa, pc, pb) <= 0) return false;
+
+	unsigned int z_min = Z(glm::min(pa, glm::min(pc, pb)));
+	unsigned int z_max = Z(glm::max(pa, glm::max(pc, pb)));
+	for(int r = node_prev_z_[c]; r != -1 && node_z_[r] >= z_min; r = node_prev_z_[r])
+		if(Blocks(r, a, c, b)) return false;
+	for(int r = node_next_z_[c]; r != -1 && node_z_[r] <= z_max; r = node_next_z_[r])
+		if(Blocks(r, a, c, b)) return false;
+	return true;
+}
+
+void Triangulator::Remove(int c) {
+	node_next_[node_prev_[c]] = node_next_[c];
+	node_prev_[node_next_[c]] = node_prev_[c];
+	if(node_prev_z_[c] != -1) node_next_z_[node_prev_z_[c]] = node_next_z_[c];
+	if(node_next_z_[c] != -1) node_prev_z_[node_next_z_[c]] = node_prev_z_[c];
+}
+
+// Every corner turns the same way around the normal, and the vertices rise and fall once in
+// lexicographic order, so the loop does not wind around twice (Schorn and Fisher).
+bool Triangulator::IsConvex(const glm::dvec3 &normal) {
+	int n = position_.size(), direction_change = 0;
+	auto Less = [](const glm::dvec3 &a, const glm::dvec3 &b) {
+		return a.x != b.x ? a.x < b.x : a.y != b.y ? a.y < b.y : a.z < b.z;
+	};
+	bool rising = Less(position_[n - 1], position_[0]);
+	for(int i = 0; i < n; i++) {
+		const glm::dvec3 &p = position_[(i + n - 1) % n], &q = position_[i], &r = position_[(i + 1) % n];
+		if(glm::dot(glm::cross(q - p, r - q), normal) <= 0) return false;
+		if(Less(q, r) != rising) {
+			rising = !rising;
+			if(++direction_change > 2) return false;
+		}
+	}
+	return true;
+}
+
+const std::vector<int> &Triangulator::Triangulate(const glm::dvec3 *outer_normal, int outer) {
+	triangle_.clear();
+	int n_contour = contour_.size() - 1;
+	if(n_contour == 0) return triangle_;
+
+	// most faces are convex without holes, a fan needs no projection
+	if(outer_normal && n_contour == 1 && position_.size() >= 3 && IsConvex(*outer_normal)) {
+		for(int i = 1; i + 1 < (int)position_.size(); i++) {
+			triangle_.push_back(0);
+			triangle_.push_back(i);
+			triangle_.push_back(i + 1);
+		}
+		return triangle_;
+	}
+
+	if(!outer_normal) outer = 0;
+	glm::dvec3 normal = outer_normal ? *outer_normal : glm::dvec3(0);
+	double length_max = -1;
+	for(int c = 0; c < n_contour && !outer_normal; c++) {
+		glm::dvec3 n(0);
+		for(int i = contour_[c]; i < contour_[c + 1]; i++) {
+			const glm::dvec3 &p = position_[i];
+			const glm::dvec3 &q = position_[i + 1 < contour_[c + 1] ? i + 1 : contour_[c]];
+			n.x += (p.y - q.y) * (p.z + q.z);
+			n.y += (p.z - q.z) * (p.x + q.x);
+			n.z += (p.x - q.x) * (p.y + q.y);
+		}
+		if(glm::dot(n, n) > length_max) {
+			length_max = glm::dot(n, n);
+			normal = n;
+			outer = c;
+		}
+	}
+
+	// drop the dominant axis of the normal, keeping the outer contour counter-clockwise
+	glm::dvec3 a = glm::abs(normal);
+	int k = a.x > a.y ? (a.x > a.z ? 0 : 2) : (a.y > a.z ? 1 : 2);
+	int u = (k + 1) % 3, v = (k + 2) % 3;
+	if(normal[k] < 0) std::swap(u, v);
+	point_.resize(position_.size());
+	for(unsigned int i = 0; i < position_.size(); i++)
+		point_[i] = glm::dvec2(position_[i][u], position_[i][v]);
+
+	node_point_.clear();
+	node_prev_.clear();
+	node_next_.clear();
+	std::vector<double> area(n_contour, 0);
+	for(int c = 0; c < n_contour; c++)
+		for(int i = contour_[c]; i < contour_[c + 1]; i++)
+			area[c] += Cross(glm::dvec2(0), point_[i], point_[i + 1 < contour_[c + 1] ? i + 1 : contour_[c]]);
+
+	if(contour_[outer + 1] == contour_[outer]) return triangle_;
+	int start = LinkContour(outer, area[outer] < 0);
+	std::vector<std::pair<double, int>> hole;
+	for(int c = 0; c < n_contour; c++) {
+		if(c == outer || contour_[c + 1] == contour_[c]) continue;
+		int first = LinkContour(c, area[c] > 0), right = first;
+		for(int node = first; node < (int)node_point_.size(); node++)
+			if(Point(node).x > Point(right).x) right = node;
+		hole.push_back(std::make_pair(Point(right).x, right));
+	}
+	std::sort(hole.begin(), hole.end(), std::greater<std::pair<double, int>>());
+	for(const auto &h: hole)
+		Split(FindBridge(h.second, start), h.second);
+
+	int remaining = node_point_.size();
+	SortZ();
+	int ear = start, stop = start;
+	while(remaining > 3) {
+		// a whole turn without an ear only happens on degenerate polygons, cut anyway
+		bool clip = IsEar(ear) || node_next_[ear] == stop;
+		int next = node_next_[ear];
+		if(clip) {
+			triangle_.push_back(node_point_[node_prev_[ear]]);
+			triangle_.push_back(node_point_[ear]);
+			triangle_.push_back(node_point_[next]);
+			Remove(ear);
+			remaining--;
+			// skipping a node avoids long fans of thin triangles
+			ear = stop = node_next_[next];
+		} else {
+			ear = next;
+		}
+	}
+	if(remaining == 3) {
+		triangle_.push_back(node_point_[node_prev_[ear]]);
+		triangle_.push_back(node_point_[ear]);
+		triangle_.push_back(node_point_[node_next_[ear]]);
+	}
+	return triangle_;
+}
+
+}
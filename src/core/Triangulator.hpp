@@ -0,0 +1,70 @@
+#pragma once
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+namespace mesher {
+
+// Ear-clipping triangulator for planar polygons with holes. The polygon is projected on
+// the plane of its largest contour, the holes are bridged into it, then ears are cut off
+// the merged polygon. A polygon with n vertices and h holes always gives n + 2h - 2
+// triangles. Scratch buffers are kept between polygons, so each thread owns one instance.
+class Triangulator {
+	std::vector<glm::dvec3> position_;
+	std::vector<int> contour_; // first vertex of each contour, then the end
+	std::vector<int> triangle_;
+
+	std::vector<glm::dvec2> point_;
+
+	// merged polygon as a doubly-linked list of nodes, a bridge visits its two ends twice
+	std::vector<int> node_point_;
+	std::vector<int> node_prev_;
+	std::vector<int> node_next_;
+	// nodes sorted by the z-order of their point, so that ear tests only visit the nodes
+	// close to the ear
+	std::vector<unsigned int> node_z_;
+	std::vector<int> node_prev_z_;
+	std::vector<int> node_next_z_;
+	glm::dvec2 z_min_;
+	double z_scale_;
+
+	const glm::dvec2 &Point(int node) {
+		return point_[node_point_[node]];
+	}
+	bool LocallyInside(int a, int b);
+	int NewNode(int point);
+	int LinkContour(int c, bool reverse);
+	int FindBridge(int hole, int outer);
+	void Split(int a, int b);
+	unsigned int Z(const glm::dvec2 &p);
+	void SortZ();
+	bool Blocks(int r, int a, int c, int b);
+	bool IsEar(int c);
+	void Remove(int c);
+	bool IsConvex(const glm::dvec3 &normal);
+
+public:
+	Triangulator() : contour_(1, 0) {}
+	void Clear();
+	void AddVertex(const glm::dvec3 &p);
+	void CloseContour();
+	// Triangles as indices of the vertices in the order they were added. Given the normal
+	// of the outer contour, that one is projected along it, otherwise the largest contour
+	// is searched for. A single convex contour turning around the given normal is cut in a
+	// fan from its first vertex.
+	const std::vector<int> &Triangulate(const glm::dvec3 *normal = nullptr, int outer = 0);
+	// Number of triangles for vertex_count vertices in contour_count non-empty contours.
+	static int TriangleCount(int vertex_count, int contour_count) {
+		int node_count = vertex_count + 2 * (contour_count - 1);
+		return node_count >= 3 ? node_count - 2 : 0;
+	}
+	const glm::dvec3 &position(int i) {
+		return position_[i];
+	}
+	const std::vector<glm::dvec3> &position() {
+		return position_;
+	}
+};
+
+}
@@ -0,0 +1,97 @@
+#include "VertexCache.hpp"
+
+#include <algorithm>
+
+namespace mesher {
+
+// Among the vertices of the last fan, the one left in the cache the longest that stays
+// there through its remaining triangles; otherwise the latest vertex with triangles left,
+// then the first one by number.
+int VertexCache::NextVertex(int cache_size, int now, int &cursor) {
+	int next = -1, priority_max = -1;
+	for(int v: candidate_) {
+		if(live_[v] <= 0) continue;
+		int priority = now - time_[v] + 2 * live_[v] <= cache_size ? now - time_[v] : 0;
+		if(priority > priority_max) {
+			priority_max = priority;
+			next = v;
+		}
+	}
+	if(next != -1) return next;
+
+	while(!dead_end_.empty()) {
+		int v = dead_end_.back();
+		dead_end_.pop_back();
+		if(live_[v] > 0) return v;
+	}
+	for(; cursor < (int)live_.size(); cursor++)
+		if(live_[cursor] > 0) return cursor;
+	return -1;
+}
+
+void VertexCache::Optimize(uint32_t *index, int triangle_count, int vertex_count, int cache_size) {
+	int index_count = 3 * triangle_count;
+	offset_.assign(vertex_count + 1, 0);
+	for(int i = 0; i < index_count; i++)
+		offset_[index[i] + 1]++;
+	for(int v = 0; v < vertex_count; v++)
+		offset_[v + 1] += offset_[v];
+	live_.assign(vertex_count, 0);
+	adjacency_.resize(index_count);
+	for(int i = 0; i < index_count; i++)
+		adjacency_[offset_[index[i]] + live_[index[i]]++] = i / 3;
+
+	time_.assign(vertex_count, 0);
+	emitted_.assign(triangle_count, false);
+	dead_end_.clear();
+	order_.clear();
+	int now = cache_size + 1, cursor = 0;
+	int fan = vertex_count ? 0 : -1;
+	while(fan != -1) {
+		candidate_.clear();
+		for(int a = offset_[fan]; a < offset_[fan + 1]; a++) {
+			int t = adjacency_[a];
+			if(emitted_[t]) continue;
+			emitted_[t] = true;
+			order_.push_back(t);
+			for(int k = 0; k < 3; k++) {
+				int v = index[3 * t + k];
+				dead_end_.push_back(v);
+				candidate_.push_back(v);
+				live_[v]--;
+				if(now - time_[v] > cache_size) time_[v] = now++;
+			}
+		}
+		fan = NextVertex(cache_size, now, cursor);
+	}
+
+	remap_.assign(vertex_count, -1);
+	int n = 0;
+	index_.resize(index_count);
+	for(int i = 0; i < triangle_count; i++)
+		for(int k = 0; k < 3; k++) {
+			int v = index[3 * order_[i] + k];
+			if(remap_[v] == -1) remap_[v] = n++;
+			index_[3 * i + k] = remap_[v];
+		}
+	for(auto &r: remap_) // vertices no triangle uses go last
+		if(r == -1) r = n++;
+	std::copy(index_.begin(), index_.end(), index);
+}
+
+double VertexCache::ACMR(const uint32_t *index, size_t index_count, int cache_size) {
+	if(index_count < 3) return 0;
+	std::vector<uint32_t> cache(cache_size);
+	size_t miss = 0;
+	int size = 0, head = 0;
+	for(size_t i = 0; i < index_count; i++) {
+		if(std::find(cache.begin(), cache.begin() + size, index[i]) != cache.begin() + size) continue;
+		miss++;
+		cache[head] = index[i];
+		head = (head + 1) % cache_size;
+		if(size < cache_size) size++;
+	}
+	return (double)miss / (index_count / 3);
+}
+
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace mesher {
+
+// Reorders indexed triangles for a post-transform vertex cache with Tipsify (Sander et al.):
+// triangles are fanned around one vertex after another, the next one taken among the
+// vertices just used that will still be in the cache for all their remaining triangles.
+// The vertices are then renumbered in the order the triangles first use them, so that they
+// are also fetched in order. Scratch buffers are kept between meshes, so each thread owns
+// one instance.
+class VertexCache {
+	std::vector<int> offset_; // of the triangles around each vertex in adjacency_
+	std::vector<int> adjacency_;
+	std::vector<int> live_; // triangles around each vertex not emitted yet
+	std::vector<int> time_; // when each vertex entered the cache
+	std::vector<char> emitted_;
+	std::vector<int> dead_end_;
+	std::vector<int> candidate_;
+	std::vector<int> order_;
+	std::vector<uint32_t> index_;
+	std::vector<int> remap_;
+
+	int NextVertex(int cache_size, int now, int &cursor);
+
+public:
+	// Reorders the triangle_count triangles of index, whose vertices are below
+	// vertex_count, for a FIFO cache of cache_size vertices, and renumbers the vertices.
+	void Optimize(uint32_t *index, int triangle_count, int vertex_count, int cache_size);
+	// New number of each vertex after Optimize().
+	const std::vector<int> &remap() {
+		return remap_;
+	}
+	// Average cache miss ratio: vertices a FIFO cache of cache_size has to load per triangle.
+	static double ACMR(const uint32_t *index, size_t index_count, int cache_size);
+};
+
+}
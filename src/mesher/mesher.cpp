@@ -17,10 +17,11 @@ int main(int argc, char *argv[]) {
 
 	/********** Mesher **********/
 	Mesher mesh;
-	mesh.LoadOperator(argv[1]);
-	mesh.Build();
-	vector<glm::vec3> &vertex = mesh.Triangulate();
-	vector<glm::vec3> &normal = mesh.triangel_normal();
+	if(!mesh.LoadOperator(argv[1]) || !mesh.Build()) return 1;
+	mesh.Triangulate();
+	vector<glm::vec3> &vertex = mesh.mesh_vertex();
+	vector<glm::vec3> &normal = mesh.mesh_normal();
+	vector<uint32_t> &index = mesh.mesh_index();
 	/********** Mesher **********/
 
 	int window_w = 1280;
@@ -31,6 +32,7 @@ int main(int argc, char *argv[]) {
 	ogl.InitGL("shader/vertex.glsl", "shader/fragment.glsl");
 	ogl.Vertex(vertex);
 	ogl.Normal(normal);
+	ogl.Index(index);
 
 	Toggle render_mode(ogl.window(), GLFW_KEY_TAB, false);
 
@@ -0,0 +1,171 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+using namespace std;
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <sys/stat.h>
+#endif
+
+#include "Mesher.hpp"
+#include "Parallel.hpp"
+using namespace mesher;
+
+bool IsDirectory(const string &path) {
+#ifdef _WIN32
+	DWORD attribute = GetFileAttributesA(path.c_str());
+	return attribute != INVALID_FILE_ATTRIBUTES && (attribute & FILE_ATTRIBUTE_DIRECTORY);
+#else
+	struct stat s;
+	return stat(path.c_str(), &s) == 0 && S_ISDIR(s.st_mode);
+#endif
+}
+
+bool EndsWith(const string &s, const string &suffix) {
+	return s.size() >= suffix.size() && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+// The .op and .opb files directly inside the directory, sorted.
+void ListModels(const string &directory, vector<string> &file) {
+	vector<string> name;
+#ifdef _WIN32
+	WIN32_FIND_DATAA data;
+	HANDLE handle = FindFirstFileA((directory + "/*.op*").c_str(), &data);
+	if(handle != INVALID_HANDLE_VALUE) {
+		do {
+			if(EndsWith(data.cFileName, ".op") || EndsWith(data.cFileName, ".opb"))
+				name.push_back(data.cFileName);
+		} while(FindNextFileA(handle, &data));
+		FindClose(handle);
+	}
+#else
+	if(DIR *dir = opendir(directory.c_str())) {
+		while(dirent *entry = readdir(dir))
+			if(EndsWith(entry->d_name, ".op") || EndsWith(entry->d_name, ".opb"))
+				name.push_back(entry->d_name);
+		closedir(dir);
+	}
+#endif
+	sort(name.begin(), name.end());
+	for(auto &n: name)
+		file.push_back(directory + "/" + n);
+}
+
+string OutputFile(const string &input, const string &output_directory) {
+	string base = input;
+	if(EndsWith(base, ".op")) base.resize(base.size() - 3);
+	else if(EndsWith(base, ".opb")) base.resize(base.size() - 4);
+	if(!output_directory.empty()) {
+		size_t slash = base.find_last_of("/\\");
+		base = output_directory + "/" + (slash == string::npos ? base : base.substr(slash + 1));
+	}
+	return base + ".mesh";
+}
+
+struct Result {
+	bool ok = false, stream = false;
+	double load = 0, build = 0, triangulate = 0, optimize = 0, save = 0;
+	double acmr = 0, acmr_optimized = 0;
+	size_t vertex = 0, triangle = 0;
+};
+
+double Milliseconds(chrono::steady_clock::time_point &t) {
+	auto now = chrono::steady_clock::now();
+	double ms = chrono::duration<double, milli>(now - t).count();
+	t = now;
+	return ms;
+}
+
+Result Process(const string &input, const string &output, bool stream, bool deep, bool optimize,
+	unsigned int thread_count) {
+	Result r;
+	r.stream = stream;
+	Mesher mesh;
+	auto t = chrono::steady_clock::now();
+	if(stream) {
+		if(!mesh.BuildStream(input.c_str())) return r;
+	} else {
+		if(!mesh.LoadOperator(input.c_str())) return r;
+		r.load = Milliseconds(t);
+		if(!mesh.Build(thread_count)) return r;
+	}
+	if(!mesh.Validate(deep)) return r;
+	r.build = Milliseconds(t);
+	mesh.Triangulate(thread_count);
+	r.triangulate = Milliseconds(t);
+	if(optimize) {
+		r.acmr = mesh.ACMR();
+		t = chrono::steady_clock::now();
+		mesh.OptimizeVertexCache(16, thread_count);
+		r.optimize = Milliseconds(t);
+		r.acmr_optimized = mesh.ACMR();
+		t = chrono::steady_clock::now();
+	}
+	r.ok = mesh.SaveMesh(output.c_str());
+	r.save = Milliseconds(t);
+	r.vertex = mesh.mesh_vertex().size();
+	r.triangle = mesh.mesh_index().size() / 3;
+	return r;
+}
+
+int main(int argc, char *argv[]) {
+	unsigned int thread_count = 0;
+	bool stream = false, deep = false, optimize = false;
+	string output_directory;
+	vector<string> input;
+	for(int i = 1; i < argc; i++) {
+		if(!strcmp(argv[i], "-j") && i + 1 < argc) thread_count = atoi(argv[++i]);
+		else if(!strcmp(argv[i], "-o") && i + 1 < argc) output_directory = argv[++i];
+		else if(!strcmp(argv[i], "-s")) stream = true;
+		else if(!strcmp(argv[i], "-v")) deep = true;
+		else if(!strcmp(argv[i], "-c")) optimize = true;
+		else if(IsDirectory(argv[i])) ListModels(argv[i], input);
+		else input.push_back(argv[i]);
+	}
+	if(input.empty()) {
+		printf("Usage: mesher_batch [-j threads] [-o output_directory] [-s] [-v] [-c] model_file|model_directory...\n");
+		printf("  -s  build while reading, without keeping the operators\n");
+		printf("  -v  check every half-edge of the built solids, not only the Euler-Poincare formula\n");
+		printf("  -c  reorder the triangles and vertices for the vertex cache, reports the cache misses per triangle\n");
+		return 0;
+	}
+
+	// several models are spread over the threads, a single one is built and triangulated with all of them
+	unsigned int model_threads = input.size() > 1 ? thread_count : 1;
+	unsigned int face_threads = input.size() > 1 ? 1 : thread_count;
+	vector<Result> result(input.size());
+	auto t = chrono::steady_clock::now();
+	ParallelFor(input.size(), model_threads, [&](unsigned int, int i) {
+		result[i] = Process(input[i], OutputFile(input[i], output_directory), stream, deep, optimize,
+			face_threads);
+	});
+	double total = Milliseconds(t);
+
+	int failed = 0;
+	for(unsigned int i = 0; i < input.size(); i++) {
+		const Result &r = result[i];
+		if(!r.ok) {
+			printf("%s: failed\n", input[i].c_str());
+			failed++;
+			continue;
+		}
+		printf("%s: %zu vertices, %zu triangles, ", input[i].c_str(), r.vertex, r.triangle);
+		if(r.stream)
+			printf("load and build %.3f ms, ", r.build);
+		else
+			printf("load %.3f ms, build %.3f ms, ", r.load, r.build);
+		printf("triangulate %.3f ms, ", r.triangulate);
+		if(optimize)
+			printf("vertex cache %.3f ms (ACMR %.3f -> %.3f), ", r.optimize, r.acmr, r.acmr_optimized);
+		printf("save %.3f ms\n", r.save);
+	}
+	printf("%zu models in %.3f ms on %u threads\n", input.size(), total, ThreadCount(thread_count));
+	return failed ? 1 : 0;
+}
@@ -0,0 +1,165 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <vector>
+using namespace std;
+
+#include "Mesher.hpp"
+#include "Simd.hpp"
+#include "Triangulator.hpp"
+using namespace mesher;
+
+double Milliseconds(chrono::steady_clock::time_point &t) {
+	auto now = chrono::steady_clock::now();
+	double ms = chrono::duration<double, milli>(now - t).count();
+	t = now;
+	return ms;
+}
+
+// Best time of repeat runs of f, in milliseconds.
+double Best(int repeat, const function<void()> &f) {
+	double best = 1e300;
+	for(int i = 0; i < repeat; i++) {
+		auto t = chrono::steady_clock::now();
+		f();
+		best = min(best, Milliseconds(t));
+	}
+	return best;
+}
+
+// Corners of the holes of a plate, counter-clockwise, on a grid of unit squares one apart.
+vector<glm::vec3> Holes(int hole_count, int &column_count, int &row_count) {
+	column_count = max(1, (int)ceil(sqrt((double)hole_count)));
+	row_count = (hole_count + column_count - 1) / column_count;
+	vector<glm::vec3> corner;
+	for(int i = 0; i < hole_count; i++) {
+		float x = 1 + 2 * (i % column_count), y = 1 + 2 * (i / column_count);
+		corner.push_back(glm::vec3(x, y, 1));
+		corner.push_back(glm::vec3(x + 1, y, 1));
+		corner.push_back(glm::vec3(x + 1, y + 1, 1));
+		corner.push_back(glm::vec3(x, y + 1, 1));
+	}
+	return corner;
+}
+
+// A square plate with hole_count square holes in its top face, swept into a solid like
+// test/model/plate.op. Each hole is hung on the first vertex by an edge, closed into a face
+// and cut loose with KeMr.
+vector<Operator> Plate(int hole_count) {
+	int column_count, row_count;
+	vector<glm::vec3> corner = Holes(hole_count, column_count, row_count);
+	float w = 2 * column_count + 1, h = 2 * row_count + 1;
+	vector<Operator> o;
+	o.push_back(Operator(Euler_Mvfs, 0, 0, 0, glm::vec3(0, 0, 1)));
+	o.push_back(Operator(Euler_Mve, 0, 0, 0, glm::vec3(w, 0, 1)));
+	o.push_back(Operator(Euler_Mve, 1, 0, 0, glm::vec3(w, h, 1)));
+	o.push_back(Operator(Euler_Mve, 2, 0, 0, glm::vec3(0, h, 1)));
+	o.push_back(Operator(Euler_Mef, 3, 0, 0));
+	for(int i = 0; i < hole_count; i++) {
+		int v = 4 + 4 * i;
+		o.push_back(Operator(Euler_Mve, 0, 0, 0, corner[4 * i]));
+		for(int k = 1; k < 4; k++)
+			o.push_back(Operator(Euler_Mve, v + k - 1, 0, 0, corner[4 * i + k]));
+		o.push_back(Operator(Euler_Mef, v, v + 3, 0));
+		o.push_back(Operator(Euler_KeMr, 4 + 5 * i, 0, 0));
+	}
+	o.push_back(Operator(Op_Sweep, 0, 0, 0, glm::vec3(0, 0, -1), 1));
+	return o;
+}
+
+int main(int argc, char *argv[]) {
+	unsigned int thread_count = 1;
+	int repeat = 3;
+	for(int i = 1; i < argc; i++) {
+		if(!strcmp(argv[i], "-j") && i + 1 < argc) thread_count = atoi(argv[++i]);
+		else if(!strcmp(argv[i], "-r") && i + 1 < argc) repeat = max(1, atoi(argv[++i]));
+		else {
+			printf("Usage: mesher_bench [-j threads] [-r repeat]\n");
+			printf("  prints the best of repeat runs of each step, triangulating on threads threads\n");
+			return 0;
+		}
+	}
+
+	for(int hole_count: {100, 1000, 10000}) {
+		vector<Operator> plate = Plate(hole_count);
+		double build = 1e300, triangulate = 1e300;
+		for(int r = 0; r < repeat; r++) {
+			Mesher mesh;
+			auto t = chrono::steady_clock::now();
+			for(auto &o: plate)
+				mesh.AddOperator(o);
+			if(!mesh.Build() || !mesh.Validate()) {
+				printf("plate with %d holes: failed\n", hole_count);
+				return 1;
+			}
+			build = min(build, Milliseconds(t));
+			mesh.Triangulate(thread_count);
+			triangulate = min(triangulate, Milliseconds(t));
+		}
+		printf("plate with %d holes: %zu operators, build %.3f ms, triangulate %.3f ms\n",
+			hole_count, plate.size(), build, triangulate);
+	}
+
+	// the top face alone, without the kernel around the triangulator
+	for(int hole_count: {100, 1000, 10000}) {
+		int column_count, row_count;
+		vector<glm::vec3> corner = Holes(hole_count, column_count, row_count);
+		float w = 2 * column_count + 1, h = 2 * row_count + 1;
+		Triangulator tri;
+		glm::dvec3 normal(0, 0, 1);
+		size_t triangle_count = 0;
+		double clip = Best(repeat, [&]() {
+			tri.Clear();
+			for(auto &p: {glm::vec3(0, 0, 1), glm::vec3(w, 0, 1), glm::vec3(w, h, 1), glm::vec3(0, h, 1)})
+				tri.AddVertex(glm::dvec3(p));
+			tri.CloseContour();
+			for(int i = 0; i < hole_count; i++) { // holes turn the other way
+				for(int k = 3; k >= 0; k--)
+					tri.AddVertex(glm::dvec3(corner[4 * i + k]));
+				tri.CloseContour();
+			}
+			triangle_count = tri.Triangulate(&normal).size() / 3;
+		});
+		printf("ear clipping %d holes: %zu triangles, %.3f ms\n", hole_count, triangle_count, clip);
+	}
+
+	// the 10000-hole plate saved and read back, as text and as binary records
+	Mesher log;
+	for(auto &o: Plate(10000))
+		log.AddOperator(o);
+	for(const char *file: {"mesher_bench.op", "mesher_bench.opb"}) {
+		if(!log.SaveOperator(file)) {
+			printf("%s: cannot be written\n", file);
+			return 1;
+		}
+		FILE *f = fopen(file, "rb");
+		fseek(f, 0, SEEK_END);
+		double size = ftell(f) / 1e6;
+		fclose(f);
+		double parse = Best(repeat, [&]() {
+			Mesher m;
+			m.LoadOperator(file);
+		});
+		remove(file);
+		printf("load %s: %.3f MB, %.3f ms, %.1f MB/s\n", file, size, parse, size / parse * 1e3);
+	}
+
+	// ToFloat() against a plain conversion loop
+	size_t n = 1 << 22;
+	vector<double> in(n);
+	vector<float> out(n);
+	for(size_t i = 0; i < n; i++)
+		in[i] = i * 0.001;
+	double simd = Best(repeat, [&]() { ToFloat(in.data(), out.data(), n); });
+	double plain = Best(repeat, [&]() {
+		for(size_t i = 0; i < n; i++)
+			out[i] = (float)in[i];
+	});
+	printf("ToFloat %zu doubles: %.3f ms, plain loop %.3f ms\n", n, simd, plain);
+	return 0;
+}
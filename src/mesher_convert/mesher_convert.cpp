@@ -0,0 +1,23 @@
+#include <cstdio>
+
+#include "Mesher.hpp"
+using namespace mesher;
+
+int main(int argc, char *argv[]) {
+	if(argc < 3) {
+		printf("Usage: mesher_convert input_file output_file\n");
+		printf("Files ending in .opb are binary operator logs, others are text.\n");
+		return 0;
+	}
+
+	Mesher mesh;
+	if(!mesh.LoadOperator(argv[1])) {
+		printf("Failed to load %s\n", argv[1]);
+		return 1;
+	}
+	if(!mesh.SaveOperator(argv[2])) {
+		printf("Failed to save %s\n", argv[2]);
+		return 1;
+	}
+	return 0;
+}
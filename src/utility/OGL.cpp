@@ -7,6 +7,7 @@
 OGL::~OGL() {
 	glDeleteBuffers(1, &vertex_buffer_);
 	glDeleteBuffers(1, &normal_buffer_);
+	glDeleteBuffers(1, &index_buffer_);
 	glDeleteVertexArrays(1, &vertex_array_);
 	glDeleteProgram(shader_);
 	glfwDestroyWindow(window_);
@@ -213,6 +214,13 @@ void OGL::Normal(std::vector<glm::vec3> &normal) {
 	);
 }
 
+void OGL::Index(std::vector<uint32_t> &index) {
+	glGenBuffers(1, &index_buffer_);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_buffer_);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(uint32_t) * index.size(), index.data(), GL_STATIC_DRAW);
+	n_index_ = index.size();
+}
+
 void OGL::MVP(glm::mat4 mvp) {
 	glUniformMatrix4fv(mvp_, 1, GL_FALSE, &mvp[0][0]);
 }
@@ -230,7 +238,10 @@ void OGL::Clear(GLenum bit) {
 }
 
 void OGL::Update() {
-	glDrawArrays(GL_TRIANGLES, 0, n_vertex_);
+	if(index_buffer_)
+		glDrawElements(GL_TRIANGLES, n_index_, GL_UNSIGNED_INT, (void*)0);
+	else
+		glDrawArrays(GL_TRIANGLES, 0, n_vertex_);
 	glfwSwapBuffers(window_);
 	glfwPollEvents();
 }
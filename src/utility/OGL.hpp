@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstdint>
 #include <vector>
 
 #include <GL/glew.h>
@@ -12,8 +13,8 @@ class OGL {
 
 	GLuint shader_;
 	GLuint mvp_, mv_;
-	GLuint vertex_array_, vertex_buffer_, normal_buffer_;
-	int n_vertex_;
+	GLuint vertex_array_, vertex_buffer_, normal_buffer_, index_buffer_ = 0;
+	int n_vertex_, n_index_ = 0;
 
 	GLuint LoadShaderFromString(const char *vertex_string, const char *fragment_string, const char *geometry_string = nullptr);
 	void LoadShader(const char *vertex_file_path, const char *fragment_file_path, const char *geometry_file_path = nullptr);
@@ -23,6 +24,8 @@ public:
 	void InitGL(const char *vertex_file_path, const char *fragment_file_path, const char *geometry_file_path = nullptr);
 	void Vertex(std::vector<glm::vec3> &vertex);
 	void Normal(std::vector<glm::vec3> &normal);
+	// Draws indexed triangles from then on instead of the plain vertex list.
+	void Index(std::vector<uint32_t> &index);
 	void MVP(glm::mat4 mvp);
 	void MV(glm::mat4 mv);
 	bool Alive();
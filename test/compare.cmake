@@ -0,0 +1,24 @@
+# Runs mesher_test on MODEL, with THREADS threads, STREAM or the CHECK when set, and compares
+# what it prints with EXPECTED. The output is left in ACTUAL to diff when they differ.
+set(command ${PROGRAM} ${MODEL})
+if(THREADS)
+	list(APPEND command -j ${THREADS})
+endif()
+if(STREAM)
+	list(APPEND command -s)
+endif()
+if(CHECK)
+	list(APPEND command -c ${CHECK})
+endif()
+execute_process(COMMAND ${command} OUTPUT_VARIABLE output RESULT_VARIABLE result)
+file(WRITE ${ACTUAL} "${output}")
+if(NOT result EQUAL 0)
+	message(FATAL_ERROR "${MODEL}: mesher_test failed (${result})")
+endif()
+
+file(READ ${EXPECTED} expected)
+string(REPLACE "\r\n" "\n" output "${output}")
+string(REPLACE "\r\n" "\n" expected "${expected}")
+if(NOT output STREQUAL expected)
+	message(FATAL_ERROR "${MODEL}: output differs from ${EXPECTED}, see ${ACTUAL}")
+endif()
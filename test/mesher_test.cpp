@@ -0,0 +1,149 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "Mesher.hpp"
+using namespace mesher;
+
+template<typename T>
+static bool Same(const std::vector<T> &a, const std::vector<T> &b) {
+	return a.size() == b.size() && !memcmp(a.data(), b.data(), sizeof(T) * a.size());
+}
+
+// Same counts and bit for bit the same indexed output of the last Triangulate().
+static bool Same(Mesher &a, Mesher &b) {
+	const Topology &s = a.topology(), &t = b.topology();
+	return s.vertex == t.vertex && s.edge == t.edge && s.face == t.face && s.loop == t.loop
+		&& s.solid == t.solid && s.hole == t.hole && Same(a.mesh_vertex(), b.mesh_vertex())
+		&& Same(a.mesh_normal(), b.mesh_normal()) && Same(a.mesh_index(), b.mesh_index());
+}
+
+// Builds the first k operators of o in a new kernel and compares it with mesh.
+static bool SamePrefix(Mesher &mesh, const std::vector<Operator> &o, unsigned int k) {
+	Mesher fresh;
+	for(unsigned int i = 0; i < k; i++)
+		fresh.AddOperator(o[i]);
+	if(!fresh.Build()) return false;
+	fresh.Triangulate();
+	mesh.Triangulate();
+	return Same(mesh, fresh);
+}
+
+// Undoes every operator, comparing with a new build of what is left each time, then redoes
+// them all.
+static bool CheckUndo(Mesher &mesh) {
+	std::vector<Operator> o = mesh.operators();
+	for(unsigned int k = o.size(); k-- > 0;)
+		if(!mesh.Undo() || !SamePrefix(mesh, o, k)) {
+			fprintf(stderr, "undo: differs after undoing to operator %u\n", k);
+			return false;
+		}
+	for(unsigned int k = 0; k < o.size(); k++)
+		if(!mesh.Redo()) {
+			fprintf(stderr, "redo: operator %u\n", k);
+			return false;
+		}
+	return SamePrefix(mesh, o, o.size());
+}
+
+// Seeks back to every operator with snapshots every few operators, then forward again,
+// comparing with a new build of the operators before it each time.
+static bool CheckSeek(Mesher &mesh) {
+	const std::vector<Operator> &o = mesh.operators();
+	std::vector<unsigned int> k;
+	for(unsigned int i = o.size(); i-- > 0;)
+		k.push_back(i);
+	for(unsigned int i = 1; i <= o.size(); i += 2)
+		k.push_back(i);
+	k.push_back(o.size());
+	for(unsigned int i: k) {
+		mesh.Seek(i);
+		if(!SamePrefix(mesh, o, i)) {
+			fprintf(stderr, "seek: differs at operator %u\n", i);
+			return false;
+		}
+	}
+	return true;
+}
+
+// Compacts the kernel and triangulates it again, which has to give the same output.
+static bool CheckCompact(Mesher &mesh) {
+	std::vector<glm::vec3> vertex = mesh.mesh_vertex(), normal = mesh.mesh_normal();
+	std::vector<uint32_t> index = mesh.mesh_index();
+	mesh.Compact();
+	mesh.Triangulate();
+	if(Same(vertex, mesh.mesh_vertex()) && Same(normal, mesh.mesh_normal()) && Same(index, mesh.mesh_index()))
+		return true;
+	fprintf(stderr, "compact: output differs\n");
+	return false;
+}
+
+// Saves the log as text and as binary records in the working directory and loads each
+// back, which has to give the same operators bit for bit.
+static bool CheckSave(Mesher &mesh, const char *file) {
+	std::string name = file;
+	name = name.substr(name.find_last_of("/\\") + 1) + ".saved";
+	for(const char *extension: {".op", ".opb"}) {
+		std::string saved = name + extension;
+		Mesher loaded;
+		bool same = mesh.SaveOperator(saved.c_str()) && loaded.LoadOperator(saved.c_str())
+			&& Same(mesh.operators(), loaded.operators());
+		remove(saved.c_str());
+		if(!same) {
+			fprintf(stderr, "save: %s does not load back the same\n", saved.c_str());
+			return false;
+		}
+	}
+	return true;
+}
+
+// Prints the faces, the counts and the triangles of a model, which test/compare.cmake
+// checks against the expected output in test/expected. A check given with -c then runs on
+// the built kernel.
+int main(int argc, char *argv[]) {
+	unsigned int thread_count = 1;
+	bool stream = false;
+	const char *check = "", *file = nullptr;
+	for(int i = 1; i < argc; i++) {
+		if(!strcmp(argv[i], "-j") && i + 1 < argc) thread_count = atoi(argv[++i]);
+		else if(!strcmp(argv[i], "-s")) stream = true;
+		else if(!strcmp(argv[i], "-c") && i + 1 < argc) check = argv[++i];
+		else file = argv[i];
+	}
+	if(!file) {
+		printf("Usage: mesher_test [-j threads] [-s] [-c check] model_file\n");
+		printf("  -s  build while reading, without keeping the operators\n");
+		printf("  -c  undo: undo every operator and compare with a build of the rest\n");
+		printf("      seek: seek to every operator and compare with a build up to it\n");
+		printf("      compact: compact and compare the triangles with the ones before\n");
+		printf("      save: save as .op and .opb and compare the operators loaded back\n");
+		return 0;
+	}
+
+	Mesher mesh;
+	mesh.KeepUndo(!strcmp(check, "undo"));
+	if(!strcmp(check, "seek")) mesh.SnapshotInterval(3);
+	bool ok = stream ? mesh.BuildStream(file) : mesh.LoadOperator(file) && mesh.Build(thread_count);
+	if(!ok || !mesh.Validate(true)) return 1;
+	mesh.Print();
+	const Topology &t = mesh.topology();
+	printf("V %d E %d F %d L %d S %d H %d\n", t.vertex, t.edge, t.face, t.loop, t.solid, t.hole);
+
+	mesh.Triangulate(thread_count);
+	std::vector<glm::vec3> &vertex = mesh.triangel_vertex();
+	std::vector<glm::vec3> &normal = mesh.triangel_normal();
+	for(size_t i = 0; i < vertex.size(); i += 3) {
+		const glm::vec3 &a = vertex[i], &b = vertex[i + 1], &c = vertex[i + 2], &n = normal[i];
+		printf("t%-3zu (%g %g %g) (%g %g %g) (%g %g %g) n (%g %g %g)\n", i / 3,
+			a.x, a.y, a.z, b.x, b.y, b.z, c.x, c.y, c.z, n.x, n.y, n.z);
+	}
+
+	if(!strcmp(check, "undo")) ok = CheckUndo(mesh);
+	else if(!strcmp(check, "seek")) ok = CheckSeek(mesh);
+	else if(!strcmp(check, "compact")) ok = CheckCompact(mesh);
+	else if(!strcmp(check, "save")) ok = CheckSave(mesh, file);
+	else if(*check) ok = !fprintf(stderr, "unknown check %s\n", check);
+	return ok && mesh.Validate(true) ? 0 : 1;
+}